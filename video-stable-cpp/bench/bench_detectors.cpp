@@ -0,0 +1,118 @@
+#include <opencv2/opencv.hpp>
+#include <opencv2/video.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+#include "../keypoint_detector.h"
+#include "synthetic_video.h"
+
+using namespace cv;
+using namespace std;
+
+// Compares the keypoint detectors the stabilizers can use (GFTT, GFTT on a 4x4
+// tile grid, FAST, ORB) with main.cpp's settings on synthetic shaky footage at
+// 720p, 1080p and 4K. For every frame pair it detects on the previous frame,
+// tracks with calcOpticalFlowPyrLK, fits a RANSAC partial affine and checks it
+// against the true camera motion. Reports detection time, corners, inliers,
+// and the mean and worst motion error: how far the estimated motion moves
+// points of a 5x5 grid over the frame from where the true motion puts them.
+//
+//     bench_detectors [frames]
+
+struct DetectorCase {
+    const char* name;
+    DetectorType type;
+    Size tiles;
+};
+
+// Mean distance between where `estimated` and `truth` put a 5x5 grid of points.
+static double motion_error(const Mat& estimated, const Mat& truth, Size size) {
+    vector<Point2f> grid, moved, expected;
+    for (int y = 0; y < 5; y++) {
+        for (int x = 0; x < 5; x++) {
+            grid.push_back(Point2f(size.width * (x + 0.5f) / 5, size.height * (y + 0.5f) / 5));
+        }
+    }
+    transform(grid, moved, estimated);
+    transform(grid, expected, truth);
+    double total = 0;
+    for (size_t i = 0; i < grid.size(); i++) {
+        total += norm(moved[i] - expected[i]);
+    }
+    return total / grid.size();
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? max(2, atoi(argv[1])) : 60;
+    Size resolutions[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const char* resolution_names[] = {"720p", "1080p", "4K"};
+    DetectorCase detectors[] = {
+        {"gftt", DETECTOR_GFTT, Size()},
+        {"gftt_tiled_4x4", DETECTOR_GFTT, Size(4, 4)},
+        {"fast", DETECTOR_FAST, Size()},
+        {"orb", DETECTOR_ORB, Size()},
+    };
+    TermCriteria termcrit(TermCriteria::COUNT | TermCriteria::EPS, 20, 0.03);
+    double tick_ms = 1000.0 / getTickFrequency();
+
+    cout << "resolution,detector,detect_ms,corners,inliers,mean_error_px,max_error_px" << endl;
+    for (int r = 0; r < 3; r++) {
+        Size size = resolutions[r];
+        SyntheticVideo video = make_shaky_video(size, frames);
+        vector<Mat> gray(frames);
+        for (int i = 0; i < frames; i++) {
+            cvtColor(video.frames[i], gray[i], COLOR_BGR2GRAY);
+        }
+
+        for (int d = 0; d < 4; d++) {
+            Ptr<KeypointDetector> detector = create_keypoint_detector(detectors[d].type, 750, 0.05, 30.0, detectors[d].tiles);
+            vector<Point2f> previous_keypoints, curr_kps, valid_previous_keypoints, valid_curr_kps;
+            vector<uchar> status, inlier_mask;
+            vector<float> err;
+            double detect_ms = 0, corners = 0, inliers = 0, total_error = 0, max_error = 0;
+
+            for (int i = 1; i < frames; i++) {
+                int64 start = getTickCount();
+                detector->detect(gray[i - 1], previous_keypoints, 750, Mat());
+                detect_ms += (getTickCount() - start) * tick_ms;
+                corners += previous_keypoints.size();
+
+                Mat estimated;
+                if (!previous_keypoints.empty()) {
+                    calcOpticalFlowPyrLK(gray[i - 1], gray[i], previous_keypoints, curr_kps, status, err, Size(31, 31), 3,
+                                         termcrit, 0, 0.001);
+                    valid_previous_keypoints.clear();
+                    valid_curr_kps.clear();
+                    for (size_t k = 0; k < status.size(); k++) {
+                        if (status[k]) {
+                            valid_previous_keypoints.push_back(previous_keypoints[k]);
+                            valid_curr_kps.push_back(curr_kps[k]);
+                        }
+                    }
+                    if (valid_curr_kps.size() >= 3) {
+                        estimated = estimateAffinePartial2D(valid_previous_keypoints, valid_curr_kps, inlier_mask, RANSAC);
+                        inliers += countNonZero(inlier_mask);
+                    }
+                }
+                if (estimated.empty()) {
+                    estimated = Mat::eye(2, 3, CV_64F);
+                }
+
+                double error = motion_error(estimated, synthetic_motion(size, video.poses[i - 1], video.poses[i]), size);
+                total_error += error;
+                max_error = max(max_error, error);
+            }
+
+            int pairs = frames - 1;
+            cout << resolution_names[r] << "," << detectors[d].name << "," << fixed << setprecision(3)
+                 << detect_ms / pairs << "," << setprecision(1) << corners / pairs << "," << inliers / pairs << ","
+                 << setprecision(3) << total_error / pairs << "," << max_error << endl;
+        }
+    }
+    return 0;
+}
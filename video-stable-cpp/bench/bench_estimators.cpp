@@ -0,0 +1,126 @@
+#include <opencv2/opencv.hpp>
+#include <opencv2/video.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+#include "../prosac_estimator.h"
+#include "synthetic_video.h"
+
+using namespace cv;
+using namespace std;
+
+// Compares the robust estimators for the frame-to-frame motion on LK matches
+// from synthetic shaky footage at 720p, 1080p and 4K: findHomography with
+// RANSAC (main.cpp), estimateAffinePartial2D with RANSAC (stabilizer-v1/v2)
+// and estimate_similarity_prosac. To exercise the robust part, a share of the
+// matches is also moved by up to 40 pixels; those keep their LK error, so
+// PROSAC gets no free hint about which ones are wrong. Reports the estimation
+// time, inliers, and the mean error against the true camera motion over a
+// 5x5 grid of points.
+//
+//     bench_estimators [frames]
+
+enum Estimator { HOMOGRAPHY_RANSAC, AFFINE_PARTIAL_RANSAC, SIMILARITY_PROSAC, ESTIMATOR_COUNT };
+
+static const char* estimator_names[ESTIMATOR_COUNT] = {
+    "findHomography_ransac", "estimateAffinePartial2D_ransac", "similarity_prosac"
+};
+
+// Mean distance between where `estimated` (2x3 or 3x3) and `truth` (2x3) put
+// a 5x5 grid of points.
+static double motion_error(const Mat& estimated, const Mat& truth, Size size) {
+    vector<Point2f> grid, moved, expected;
+    for (int y = 0; y < 5; y++) {
+        for (int x = 0; x < 5; x++) {
+            grid.push_back(Point2f(size.width * (x + 0.5f) / 5, size.height * (y + 0.5f) / 5));
+        }
+    }
+    if (estimated.rows == 3) perspectiveTransform(grid, moved, estimated);
+    else transform(grid, moved, estimated);
+    transform(grid, expected, truth);
+    double total = 0;
+    for (size_t i = 0; i < grid.size(); i++) {
+        total += norm(moved[i] - expected[i]);
+    }
+    return total / grid.size();
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? max(2, atoi(argv[1])) : 60;
+    Size resolutions[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const char* resolution_names[] = {"720p", "1080p", "4K"};
+    double outlier_ratios[] = {0.0, 0.3};
+    TermCriteria termcrit(TermCriteria::COUNT | TermCriteria::EPS, 20, 0.03);
+    double tick_ms = 1000.0 / getTickFrequency();
+
+    cout << "resolution,outliers,estimator,matches,estimate_ms,inliers,mean_error_px" << endl;
+    for (int r = 0; r < 3; r++) {
+        Size size = resolutions[r];
+        SyntheticVideo video = make_shaky_video(size, frames);
+        vector<Mat> gray(frames);
+        for (int i = 0; i < frames; i++) {
+            cvtColor(video.frames[i], gray[i], COLOR_BGR2GRAY);
+        }
+
+        for (int o = 0; o < 2; o++) {
+            RNG rng(4242);
+            double matches = 0, time_ms[ESTIMATOR_COUNT] = {0}, inliers[ESTIMATOR_COUNT] = {0},
+                   error[ESTIMATOR_COUNT] = {0};
+
+            vector<Point2f> keypoints, tracked, from, to;
+            vector<uchar> status, inlier_mask;
+            vector<float> err, quality;
+            for (int i = 1; i < frames; i++) {
+                goodFeaturesToTrack(gray[i - 1], keypoints, 750, 0.05, 30.0, Mat(), 3, false, 0.04);
+                calcOpticalFlowPyrLK(gray[i - 1], gray[i], keypoints, tracked, status, err, Size(31, 31), 3, termcrit,
+                                     0, 0.001);
+                from.clear();
+                to.clear();
+                quality.clear();
+                for (size_t k = 0; k < status.size(); k++) {
+                    if (!status[k]) continue;
+                    Point2f target = tracked[k];
+                    if (rng.uniform(0.0, 1.0) < outlier_ratios[o]) {
+                        target += Point2f(rng.uniform(-40.f, 40.f), rng.uniform(-40.f, 40.f));
+                    }
+                    from.push_back(keypoints[k]);
+                    to.push_back(target);
+                    quality.push_back(err[k]);
+                }
+                matches += from.size();
+                if (from.size() < 4) continue;
+
+                Mat truth = synthetic_motion(size, video.poses[i - 1], video.poses[i]);
+                for (int e = 0; e < ESTIMATOR_COUNT; e++) {
+                    Mat estimated;
+                    int64 start = getTickCount();
+                    if (e == HOMOGRAPHY_RANSAC) {
+                        estimated = findHomography(from, to, RANSAC, 3, inlier_mask);
+                    } else if (e == AFFINE_PARTIAL_RANSAC) {
+                        estimated = estimateAffinePartial2D(from, to, inlier_mask, RANSAC);
+                    } else {
+                        estimated = estimate_similarity_prosac(from, to, quality, inlier_mask);
+                    }
+                    time_ms[e] += (getTickCount() - start) * tick_ms;
+                    if (estimated.empty()) estimated = Mat::eye(2, 3, CV_64F);
+                    inliers[e] += countNonZero(inlier_mask);
+                    error[e] += motion_error(estimated, truth, size);
+                }
+            }
+
+            int pairs = frames - 1;
+            for (int e = 0; e < ESTIMATOR_COUNT; e++) {
+                cout << resolution_names[r] << "," << fixed << setprecision(1) << outlier_ratios[o] << ","
+                     << estimator_names[e] << "," << matches / pairs << "," << setprecision(3) << time_ms[e] / pairs
+                     << "," << setprecision(1) << inliers[e] / pairs << "," << setprecision(3) << error[e] / pairs
+                     << endl;
+            }
+        }
+    }
+    return 0;
+}
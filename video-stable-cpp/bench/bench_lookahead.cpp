@@ -0,0 +1,58 @@
+#include <opencv2/core.hpp>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+#include "../lookahead_smoother.h"
+
+using namespace cv;
+using namespace std;
+
+// Output latency against smoothing quality of LookaheadSmoother for a range
+// of lookaheads, with a 25-frame history as in main.cpp's default smoothing
+// radius. The input is a synthetic camera path: a steady pan with a slow turn
+// plus random shake. For each lookahead it reports the delay in frames and in
+// ms at 30 fps, and the RMS distance between the stabilized path and the
+// shake-free one. "buffered_25" is the default mode's delay for comparison.
+//
+//     bench_lookahead [frames]
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? max(100, atoi(argv[1])) : 3000;
+    const int history = 25;
+    const double frame_ms = 1000.0 / 30.0;
+
+    RNG rng(12345);
+    vector<Vec3d> intended(frames), trajectory(frames);
+    for (int i = 0; i < frames; i++) {
+        intended[i] = Vec3d(1.5 * i, 20.0 * sin(i / 90.0), 0.002 * i);
+        Vec3d shake(rng.gaussian(4.0), rng.gaussian(4.0), rng.gaussian(0.005));
+        trajectory[i] = intended[i] + shake;
+    }
+
+    cout << "mode,lookahead_frames,latency_ms_at_30fps,rms_dx,rms_dy,rms_da" << endl;
+    cout << "buffered_25," << history << "," << fixed << setprecision(1) << history * frame_ms << ",,," << endl;
+
+    int lookaheads[] = {0, 1, 2, 4, 8, 12};
+    for (int l = 0; l < 6; l++) {
+        int k = lookaheads[l];
+        LookaheadSmoother smoother(history, k);
+        Vec3d squared(0, 0, 0);
+        int count = 0;
+        for (int i = 0; i < frames; i++) {
+            smoother.push(trajectory[i]);
+            int t = i - k;
+            // Skip the warm-up, where the window is still filling
+            if (t < history) continue;
+            Vec3d residual = trajectory[t] + smoother.correction(k) - intended[t];
+            for (int c = 0; c < 3; c++) squared[c] += residual[c] * residual[c];
+            count++;
+        }
+        cout << "lookahead," << k << "," << setprecision(1) << k * frame_ms << "," << setprecision(3)
+             << sqrt(squared[0] / count) << "," << sqrt(squared[1] / count) << "," << setprecision(5)
+             << sqrt(squared[2] / count) << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <opencv2/opencv.hpp>
+#include <opencv2/video.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+#include "../frame_preprocessor.h"
+#include "../processing_resize.h"
+#include "synthetic_video.h"
+
+using namespace cv;
+using namespace std;
+
+// Compares the preprocessing modes of the stabilizers on synthetic shaky
+// footage at 720p, 1080p and 4K, once with steady lighting and once with a
+// random exposure change (gain and offset) on every frame. For each mode it
+// reports the preprocessing cost, the share of detected keypoints that
+// optical flow tracks into the next frame, and the mean error of the
+// estimated motion against the true camera motion, in full-resolution pixels
+// at the centre of the frame. "clahe_960" runs CLAHE on an estimation image
+// downscaled to 960 pixels, as with --max-dim 960.
+//
+//     bench_preprocess [frames]
+
+struct PreprocessCase {
+    const char* name;
+    PreprocessMode mode;
+    int max_dim;
+};
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? max(2, atoi(argv[1])) : 60;
+    Size resolutions[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const char* resolution_names[] = {"720p", "1080p", "4K"};
+    PreprocessCase cases[] = {
+        {"off", PREPROCESS_OFF, 0},
+        {"clahe", PREPROCESS_CLAHE, 0},
+        {"clahe_960", PREPROCESS_CLAHE, 960},
+        {"normalize", PREPROCESS_NORMALIZE, 0},
+    };
+    TermCriteria termcrit(TermCriteria::COUNT | TermCriteria::EPS, 20, 0.03);
+    double tick_ms = 1000.0 / getTickFrequency();
+
+    cout << "resolution,lighting,mode,preprocess_ms,keypoints,survival,mean_error_px" << endl;
+    for (int r = 0; r < 3; r++) {
+        Size size = resolutions[r];
+        SyntheticVideo video = make_shaky_video(size, frames);
+
+        for (int lighting = 0; lighting < 2; lighting++) {
+            vector<Mat> full_gray(frames);
+            RNG rng(777);
+            for (int i = 0; i < frames; i++) {
+                cvtColor(video.frames[i], full_gray[i], COLOR_BGR2GRAY);
+                if (lighting == 1) {
+                    full_gray[i].convertTo(full_gray[i], -1, rng.uniform(0.6, 1.4), rng.uniform(-40.0, 40.0));
+                }
+            }
+
+            for (int c = 0; c < 4; c++) {
+                FramePreprocessor preprocessor(cases[c].mode);
+                double scale = processing_scale(size, cases[c].max_dim);
+                vector<Point2f> previous_keypoints, curr_kps, valid_previous_keypoints, valid_curr_kps;
+                vector<uchar> status;
+                vector<float> err;
+                Mat previous, gray;
+                double preprocess_ms = 0, keypoints = 0, tracked = 0, total_error = 0;
+
+                for (int i = 0; i < frames; i++) {
+                    if (scale != 1.0) {
+                        gray.create(processing_size(size, scale), CV_8UC1);
+                        resize_for_processing(full_gray[i], gray);
+                    } else {
+                        full_gray[i].copyTo(gray);
+                    }
+                    int64 start = getTickCount();
+                    preprocessor.apply(gray);
+                    preprocess_ms += (getTickCount() - start) * tick_ms;
+
+                    if (i > 0 && !previous_keypoints.empty()) {
+                        calcOpticalFlowPyrLK(previous, gray, previous_keypoints, curr_kps, status, err, Size(31, 31), 3,
+                                             termcrit, 0, 0.001);
+                        valid_previous_keypoints.clear();
+                        valid_curr_kps.clear();
+                        for (size_t k = 0; k < status.size(); k++) {
+                            if (status[k]) {
+                                valid_previous_keypoints.push_back(previous_keypoints[k] * (1.0 / scale));
+                                valid_curr_kps.push_back(curr_kps[k] * (1.0 / scale));
+                            }
+                        }
+                        keypoints += previous_keypoints.size();
+                        tracked += valid_curr_kps.size();
+
+                        Mat estimated;
+                        if (valid_curr_kps.size() >= 3) {
+                            estimated = estimateAffinePartial2D(valid_previous_keypoints, valid_curr_kps, noArray(), RANSAC);
+                        }
+                        if (estimated.empty()) {
+                            estimated = Mat::eye(2, 3, CV_64F);
+                        }
+                        Mat truth = synthetic_motion(size, video.poses[i - 1], video.poses[i]);
+                        vector<Point2f> centre(1, Point2f(size.width / 2.0f, size.height / 2.0f)), moved, expected;
+                        transform(centre, moved, estimated);
+                        transform(centre, expected, truth);
+                        total_error += norm(moved[0] - expected[0]);
+                    }
+
+                    goodFeaturesToTrack(gray, previous_keypoints, 750, 0.05, 30.0 * scale, Mat(), 3, false, 0.04);
+                    gray.copyTo(previous);
+                }
+
+                int pairs = frames - 1;
+                cout << resolution_names[r] << "," << (lighting ? "flicker" : "steady") << "," << cases[c].name << ","
+                     << fixed << setprecision(3) << preprocess_ms / frames << "," << setprecision(1)
+                     << keypoints / pairs << "," << setprecision(3) << (keypoints > 0 ? tracked / keypoints : 0.0)
+                     << "," << total_error / pairs << endl;
+            }
+        }
+    }
+    return 0;
+}
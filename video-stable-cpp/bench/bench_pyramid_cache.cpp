@@ -0,0 +1,64 @@
+#include <opencv2/opencv.hpp>
+#include <opencv2/video.hpp>
+#include <opencv2/imgproc.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+#include "../pyramid_cache.h"
+#include "synthetic_video.h"
+
+using namespace cv;
+using namespace std;
+
+// Compares calcOpticalFlowPyrLK on raw gray images (both pyramids rebuilt on
+// every call) with PyramidCache (each pyramid built once) at 720p, 1080p and 4K.
+
+static vector<Mat> make_sequence(Size size, int frames) {
+    SyntheticVideo video = make_shaky_video(size, frames);
+    vector<Mat> sequence(frames);
+    for (int i = 0; i < frames; i++) {
+        cvtColor(video.frames[i], sequence[i], COLOR_BGR2GRAY);
+    }
+    return sequence;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 60;
+    Size resolutions[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const char* names[] = {"720p", "1080p", "4K"};
+
+    TermCriteria termcrit(TermCriteria::COUNT | TermCriteria::EPS, 20, 0.03);
+    double tick_ms = 1000.0 / getTickFrequency();
+
+    cout << "resolution,frames,uncached_ms_per_frame,cached_ms_per_frame,saving_percent" << endl;
+    for (int r = 0; r < 3; r++) {
+        vector<Mat> sequence = make_sequence(resolutions[r], frames);
+
+        vector<Point2f> keypoints;
+        goodFeaturesToTrack(sequence[0], keypoints, 750, 0.05, 30.0, Mat(), 3, false, 0.04);
+
+        vector<Point2f> curr_kps;
+        vector<uchar> status;
+        vector<float> err;
+
+        int64 start = getTickCount();
+        for (int i = 1; i < frames; i++) {
+            calcOpticalFlowPyrLK(sequence[i - 1], sequence[i], keypoints, curr_kps, status, err, Size(31, 31), 3, termcrit, 0, 0.001);
+        }
+        double uncached = (getTickCount() - start) * tick_ms / (frames - 1);
+
+        PyramidCache cache(Size(31, 31), 3);
+        start = getTickCount();
+        cache.reset(sequence[0]);
+        for (int i = 1; i < frames; i++) {
+            cache.track(sequence[i], keypoints, curr_kps, status, err, termcrit, 0, 0.001);
+        }
+        double cached = (getTickCount() - start) * tick_ms / (frames - 1);
+
+        cout << names[r] << "," << frames << "," << fixed << setprecision(3) << uncached << "," << cached << ","
+             << setprecision(1) << 100.0 * (uncached - cached) / uncached << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <opencv2/opencv.hpp>
+#include <opencv2/video.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../pyramid_cache.h"
+#include "../trajectory_smoother.h"
+#include "synthetic_video.h"
+
+using namespace cv;
+using namespace std;
+
+// Times every stage of the stabilizer loop separately on synthetic shaky
+// footage at 720p, 1080p and 4K, with the settings of each Stabilizer variant
+// (main.cpp, stabilizer-v1.cpp, stabilizer-v2.cpp). Prints CSV, or JSON with
+// --json, one record per variant, resolution and stage.
+//
+//     bench_stages [frames] [--json]
+
+struct Variant {
+    const char* name;
+    int max_corners;
+    double quality_level;
+    bool homography;  // findHomography + warpPerspective instead of estimateAffinePartial2D + warpAffine
+    SmootherType smoother;
+    double process_noise_cov;
+};
+
+enum Stage { CVT_COLOR, CLAHE_STAGE, GFTT, OPTICAL_FLOW, RANSAC_STAGE, SMOOTHER, BORDER, WARP, STAGE_COUNT };
+
+static const char* stage_names[STAGE_COUNT] = {
+    "cvtColor", "clahe", "goodFeaturesToTrack", "calcOpticalFlowPyrLK", "ransac", "smoother", "border", "warp"
+};
+
+struct StageTimes {
+    double total_ms, min_ms, max_ms;
+    int count;
+
+    StageTimes() : total_ms(0), min_ms(1e300), max_ms(0), count(0) {}
+
+    void add(double ms) {
+        total_ms += ms;
+        min_ms = min(min_ms, ms);
+        max_ms = max(max_ms, ms);
+        count++;
+    }
+};
+
+// Runs `f` and adds its wall time to `times`.
+template <typename F>
+static void timed(StageTimes& times, F f) {
+    int64 start = getTickCount();
+    f();
+    times.add((getTickCount() - start) * 1000.0 / getTickFrequency());
+}
+
+static void run_variant(const Variant& variant, const SyntheticVideo& video, StageTimes* times) {
+    const int border_size = 30;
+    const int smoothing_radius = 25;
+    TermCriteria termcrit(TermCriteria::COUNT | TermCriteria::EPS, 20, 0.03);
+
+    Ptr<CLAHE> clahe = createCLAHE(2.0, Size(8, 8));
+    Ptr<TrajectorySmoother> smoother = create_trajectory_smoother(variant.smoother, smoothing_radius,
+                                                                  variant.process_noise_cov, 1e-1);
+    PyramidCache pyramid_cache;
+
+    Mat gray, bordered, warped;
+    vector<Point2f> previous_keypoints, curr_kps, valid_curr_kps, valid_previous_keypoints;
+    vector<uchar> status;
+    vector<float> err;
+
+    cvtColor(video.frames[0], gray, COLOR_BGR2GRAY);
+    clahe->apply(gray, gray);
+    goodFeaturesToTrack(gray, previous_keypoints, variant.max_corners, variant.quality_level, 30.0, Mat(), 3, false, 0.04);
+    pyramid_cache.reset(gray);
+
+    for (size_t i = 1; i < video.frames.size(); i++) {
+        const Mat& frame = video.frames[i];
+
+        timed(times[CVT_COLOR], [&] { cvtColor(frame, gray, COLOR_BGR2GRAY); });
+        timed(times[CLAHE_STAGE], [&] { clahe->apply(gray, gray); });
+        timed(times[OPTICAL_FLOW], [&] {
+            pyramid_cache.track(gray, previous_keypoints, curr_kps, status, err, termcrit, 0, 0.001);
+        });
+
+        valid_curr_kps.clear();
+        valid_previous_keypoints.clear();
+        for (size_t k = 0; k < status.size(); k++) {
+            if (status[k]) {
+                valid_curr_kps.push_back(curr_kps[k]);
+                valid_previous_keypoints.push_back(previous_keypoints[k]);
+            }
+        }
+
+        Mat transformation;
+        timed(times[RANSAC_STAGE], [&] {
+            if (valid_curr_kps.size() < 4) {
+                transformation = variant.homography ? Mat::eye(3, 3, CV_64F) : Mat::eye(2, 3, CV_64F);
+            } else if (variant.homography) {
+                transformation = findHomography(valid_previous_keypoints, valid_curr_kps, RANSAC);
+            } else {
+                transformation = estimateAffinePartial2D(valid_previous_keypoints, valid_curr_kps, noArray(), RANSAC);
+            }
+            if (transformation.empty()) {
+                transformation = variant.homography ? Mat::eye(3, 3, CV_64F) : Mat::eye(2, 3, CV_64F);
+            }
+        });
+
+        Vec3d motion(transformation.at<double>(0, 2), transformation.at<double>(1, 2),
+                     atan2(transformation.at<double>(1, 0), transformation.at<double>(0, 0)));
+        Vec3d smoothed;
+        timed(times[SMOOTHER], [&] { smoothed = smoother->update(motion); });
+
+        timed(times[BORDER], [&] {
+            copyMakeBorder(frame, bordered, border_size, border_size, border_size, border_size, BORDER_CONSTANT, Scalar(0, 0, 0));
+        });
+        timed(times[WARP], [&] {
+            double c = cos(smoothed[2]), s = sin(smoothed[2]);
+            if (variant.homography) {
+                Mat transform = (Mat_<double>(3, 3) << c, -s, smoothed[0], s, c, smoothed[1], 0, 0, 1);
+                warpPerspective(bordered, warped, transform, bordered.size(), INTER_LINEAR, BORDER_CONSTANT, Scalar(0, 0, 0));
+            } else {
+                Mat transform = (Mat_<double>(2, 3) << c, -s, smoothed[0], s, c, smoothed[1]);
+                warpAffine(bordered, warped, transform, bordered.size(), INTER_LINEAR, BORDER_CONSTANT, Scalar(0, 0, 0));
+            }
+        });
+
+        // The stabilizers re-detect on every frame unless keypoint tracking is enabled
+        timed(times[GFTT], [&] {
+            goodFeaturesToTrack(gray, previous_keypoints, variant.max_corners, variant.quality_level, 30.0, Mat(), 3, false, 0.04);
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    int frames = 60;
+    bool json = false;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--json") json = true;
+        else frames = max(2, atoi(argv[i]));
+    }
+
+    Size resolutions[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const char* resolution_names[] = {"720p", "1080p", "4K"};
+    Variant variants[] = {
+        {"main", 750, 0.05, true, SMOOTHER_KALMAN, 1e-3},
+        {"v1", 200, 0.05, false, SMOOTHER_MOVING_AVERAGE, 1e-3},
+        {"v2", 500, 0.01, false, SMOOTHER_KALMAN, 1e-5},
+    };
+
+    if (json) cout << "[" << endl;
+    else cout << "variant,resolution,stage,frames,mean_ms,min_ms,max_ms" << endl;
+
+    bool first = true;
+    for (int r = 0; r < 3; r++) {
+        SyntheticVideo video = make_shaky_video(resolutions[r], frames);
+        for (int v = 0; v < 3; v++) {
+            StageTimes times[STAGE_COUNT];
+            run_variant(variants[v], video, times);
+
+            for (int s = 0; s < STAGE_COUNT; s++) {
+                double mean_ms = times[s].total_ms / times[s].count;
+                cout << fixed << setprecision(3);
+                if (json) {
+                    cout << (first ? "  " : ",\n  ") << "{\"variant\": \"" << variants[v].name
+                         << "\", \"resolution\": \"" << resolution_names[r] << "\", \"stage\": \"" << stage_names[s]
+                         << "\", \"frames\": " << times[s].count << ", \"mean_ms\": " << mean_ms
+                         << ", \"min_ms\": " << times[s].min_ms << ", \"max_ms\": " << times[s].max_ms << "}";
+                } else {
+                    cout << variants[v].name << "," << resolution_names[r] << "," << stage_names[s] << ","
+                         << times[s].count << "," << mean_ms << "," << times[s].min_ms << "," << times[s].max_ms << endl;
+                }
+                first = false;
+            }
+        }
+    }
+    if (json) cout << "\n]" << endl;
+    return 0;
+}
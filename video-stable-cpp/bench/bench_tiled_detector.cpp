@@ -0,0 +1,69 @@
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+#include "../tiled_detector.h"
+#include "synthetic_video.h"
+
+using namespace cv;
+using namespace std;
+
+// Compares full-frame goodFeaturesToTrack with detect_tiled_corners on a 4x4
+// grid at 720p, 1080p and 4K: time per frame, corners found, and coverage,
+// the share of cells of an 8x8 grid that hold at least one corner.
+
+static double coverage(const vector<Point2f>& corners, Size size) {
+    const int cells = 8;
+    vector<bool> occupied(cells * cells, false);
+    for (size_t i = 0; i < corners.size(); i++) {
+        int cx = min(cells - 1, static_cast<int>(corners[i].x * cells / size.width));
+        int cy = min(cells - 1, static_cast<int>(corners[i].y * cells / size.height));
+        occupied[cy * cells + cx] = true;
+    }
+    int count = 0;
+    for (size_t i = 0; i < occupied.size(); i++) count += occupied[i];
+    return static_cast<double>(count) / occupied.size();
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? max(1, atoi(argv[1])) : 30;
+    Size resolutions[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const char* names[] = {"720p", "1080p", "4K"};
+    double tick_ms = 1000.0 / getTickFrequency();
+
+    cout << "resolution,detector,threads,ms_per_frame,corners,coverage" << endl;
+    for (int r = 0; r < 3; r++) {
+        SyntheticVideo video = make_shaky_video(resolutions[r], frames);
+        vector<Mat> gray(frames);
+        for (int i = 0; i < frames; i++) {
+            cvtColor(video.frames[i], gray[i], COLOR_BGR2GRAY);
+        }
+
+        vector<Point2f> corners;
+        double corner_total = 0, coverage_total = 0;
+        int64 start = getTickCount();
+        for (int i = 0; i < frames; i++) {
+            goodFeaturesToTrack(gray[i], corners, 750, 0.05, 30.0, Mat(), 3, false, 0.04);
+            corner_total += corners.size();
+            coverage_total += coverage(corners, resolutions[r]);
+        }
+        double full_ms = (getTickCount() - start) * tick_ms / frames;
+        cout << names[r] << ",full," << getNumThreads() << "," << fixed << setprecision(3) << full_ms << ","
+             << setprecision(1) << corner_total / frames << "," << setprecision(3) << coverage_total / frames << endl;
+
+        corner_total = coverage_total = 0;
+        start = getTickCount();
+        for (int i = 0; i < frames; i++) {
+            detect_tiled_corners(gray[i], corners, 750, 0.05, 30.0, Mat(), Size(4, 4));
+            corner_total += corners.size();
+            coverage_total += coverage(corners, resolutions[r]);
+        }
+        double tiled_ms = (getTickCount() - start) * tick_ms / frames;
+        cout << names[r] << ",tiled_4x4," << getNumThreads() << "," << fixed << setprecision(3) << tiled_ms << ","
+             << setprecision(1) << corner_total / frames << "," << setprecision(3) << coverage_total / frames << endl;
+    }
+    return 0;
+}
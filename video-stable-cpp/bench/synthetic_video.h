@@ -0,0 +1,81 @@
+#ifndef SYNTHETIC_VIDEO_H
+#define SYNTHETIC_VIDEO_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <cmath>
+#include <vector>
+
+// Deterministic shaky footage for the benchmarks: a textured BGR scene seen
+// through a camera that jitters by a known random translation and rotation on
+// every frame. The same seed always gives the same frames.
+struct SyntheticVideo {
+    std::vector<cv::Mat> frames;
+    // Camera pose (x, y, angle) of each frame, in pixels and radians.
+    std::vector<cv::Vec3d> poses;
+};
+
+// Blurred colour noise with hard-edged rectangles on top, so there are both
+// texture for optical flow and corners for the detectors.
+inline cv::Mat make_synthetic_scene(cv::Size size, cv::RNG& rng) {
+    cv::Mat noise(size, CV_8UC3);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat scene;
+    cv::GaussianBlur(noise, scene, cv::Size(0, 0), 2.0);
+
+    int shapes = size.area() / 5000;
+    for (int i = 0; i < shapes; i++) {
+        cv::Point corner(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        cv::Size extent(rng.uniform(8, 64), rng.uniform(8, 64));
+        cv::Scalar color(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
+        cv::rectangle(scene, cv::Rect(corner, extent), color, -1);
+    }
+    return scene;
+}
+
+// Maps pixels of a frame with camera `pose` to scene pixels, `margin` being
+// the scene border around the frame area.
+inline cv::Mat synthetic_camera(cv::Size size, const cv::Vec3d& pose, int margin) {
+    cv::Point2f centre(size.width / 2.0f, size.height / 2.0f);
+    cv::Mat camera = cv::getRotationMatrix2D(centre, pose[2] * 180.0 / CV_PI, 1.0);
+    camera.at<double>(0, 2) += margin + pose[0];
+    camera.at<double>(1, 2) += margin + pose[1];
+    return camera;
+}
+
+// True 2x3 motion taking pixels of the frame with pose `from` to the same
+// scene points in the frame with pose `to`, which is what the stabilizers
+// estimate between consecutive frames.
+inline cv::Mat synthetic_motion(cv::Size size, const cv::Vec3d& from, const cv::Vec3d& to) {
+    cv::Mat from_camera = cv::Mat::eye(3, 3, CV_64F);
+    cv::Mat to_camera = cv::Mat::eye(3, 3, CV_64F);
+    synthetic_camera(size, from, 0).copyTo(from_camera.rowRange(0, 2));
+    synthetic_camera(size, to, 0).copyTo(to_camera.rowRange(0, 2));
+    cv::Mat motion = to_camera.inv() * from_camera;
+    return motion.rowRange(0, 2).clone();
+}
+
+// `count` frames of `size` with up to `max_shift` pixels and `max_angle`
+// radians of jitter around the scene centre.
+inline SyntheticVideo make_shaky_video(cv::Size size, int count, unsigned seed = 12345,
+                                       double max_shift = 8.0, double max_angle = 0.01) {
+    cv::RNG rng(seed);
+    // Room for the largest shift, plus the corners swinging out under rotation
+    int margin = static_cast<int>(std::ceil(max_shift + std::sin(max_angle) * (size.width + size.height))) + 32;
+    cv::Size scene_size(size.width + 2 * margin, size.height + 2 * margin);
+    cv::Mat scene = make_synthetic_scene(scene_size, rng);
+
+    SyntheticVideo video;
+    for (int i = 0; i < count; i++) {
+        cv::Vec3d pose(rng.uniform(-max_shift, max_shift), rng.uniform(-max_shift, max_shift),
+                       rng.uniform(-max_angle, max_angle));
+
+        cv::Mat frame;
+        cv::warpAffine(scene, frame, synthetic_camera(size, pose, margin), size, cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REFLECT);
+        video.frames.push_back(frame);
+        video.poses.push_back(pose);
+    }
+    return video;
+}
+
+#endif // SYNTHETIC_VIDEO_H
@@ -0,0 +1,103 @@
+#ifndef DEADLINE_CONTROLLER_H
+#define DEADLINE_CONTROLLER_H
+
+#include <algorithm>
+#include <cstddef>
+
+// How much work a real-time stabilizer skips to stay inside its deadline.
+// Every level also applies the ones before it.
+enum DegradationLevel {
+    DEGRADE_NONE,
+    DEGRADE_FEWER_FEATURES,    // half the corner budget
+    DEGRADE_LOWER_RESOLUTION,  // estimate motion on a smaller image
+    DEGRADE_PREDICT,           // use the smoother's prediction instead of estimating
+    DEGRADE_DROP,              // skip the frame entirely
+    DEGRADATION_LEVEL_COUNT
+};
+
+inline const char* degradation_level_name(int level) {
+    static const char* names[DEGRADATION_LEVEL_COUNT] = {
+        "none", "fewer_features", "lower_resolution", "predict", "drop"
+    };
+    return names[level];
+}
+
+// Picks the degradation level for each frame from the time the previous
+// frames took against a per-frame deadline.
+//
+// The deadline is at risk when a frame overruns it, or when the moving
+// average of frame times passes 85% of it; either steps one level down.
+// Stepping back up needs `recover_frames` frames in a row under half the
+// deadline, so the level does not flap between two settings. Frames that
+// were dropped are not timed; they would make any level look cheap.
+class DeadlineController {
+public:
+    explicit DeadlineController(double deadline_ms, int recover_frames = 15)
+        : deadline_ms(deadline_ms), recover_frames(recover_frames), current(DEGRADE_NONE),
+          mean_ms(0), timed_frames(0), fast_streak(0), frame_count(0) {
+        std::fill(counts, counts + DEGRADATION_LEVEL_COUNT, 0);
+    }
+
+    // Level to run the next frame at; counts it towards usage().
+    DegradationLevel next_level() {
+        counts[current]++;
+        frame_count++;
+        return current;
+    }
+
+    // Wall time of the frame just processed.
+    void report(double frame_ms) {
+        mean_ms = timed_frames == 0 ? frame_ms : mean_ms + 0.2 * (frame_ms - mean_ms);
+        timed_frames++;
+
+        if (frame_ms > deadline_ms || mean_ms > 0.85 * deadline_ms) {
+            fast_streak = 0;
+            if (current < DEGRADE_DROP) {
+                current = static_cast<DegradationLevel>(current + 1);
+                // Start the new level from the deadline rather than the overrun
+                mean_ms = std::min(mean_ms, 0.85 * deadline_ms);
+            }
+        } else if (frame_ms < 0.5 * deadline_ms) {
+            if (++fast_streak >= recover_frames && current > DEGRADE_NONE) {
+                current = static_cast<DegradationLevel>(current - 1);
+                fast_streak = 0;
+            }
+        } else {
+            fast_streak = 0;
+        }
+    }
+
+    // While frames are being dropped nothing is timed, so count the dropped
+    // ones towards recovery instead.
+    void report_dropped() {
+        if (++fast_streak >= recover_frames && current > DEGRADE_NONE) {
+            current = static_cast<DegradationLevel>(current - 1);
+            fast_streak = 0;
+        }
+    }
+
+    DegradationLevel level() const { return current; }
+
+    double deadline() const { return deadline_ms; }
+
+    // Fraction of frames that ran at `level`.
+    double usage(DegradationLevel level) const {
+        return frame_count > 0 ? static_cast<double>(counts[level]) / frame_count : 0.0;
+    }
+
+    size_t frames() const { return frame_count; }
+
+private:
+    double deadline_ms;
+    int recover_frames;
+    DegradationLevel current;
+
+    double mean_ms;
+    size_t timed_frames;
+    int fast_streak;
+
+    size_t counts[DEGRADATION_LEVEL_COUNT];
+    size_t frame_count;
+};
+
+#endif // DEADLINE_CONTROLLER_H
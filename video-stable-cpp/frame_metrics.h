@@ -0,0 +1,248 @@
+#ifndef FRAME_METRICS_H
+#define FRAME_METRICS_H
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum MetricStage {
+    STAGE_GRAY,          // cvtColor and processing resize
+    STAGE_PREPROCESS,    // CLAHE or contrast normalization
+    STAGE_OPTICAL_FLOW,  // pyramid build and calcOpticalFlowPyrLK
+    STAGE_RANSAC,        // robust transform estimation
+    STAGE_DETECT,        // keypoint (re-)detection
+    STAGE_SMOOTH,        // trajectory smoother update
+    STAGE_WARP,          // output warp, measured on the warp side
+    METRIC_STAGE_COUNT
+};
+
+inline const char* metric_stage_name(int stage) {
+    static const char* names[METRIC_STAGE_COUNT] = {"gray", "preprocess", "optical_flow", "ransac", "detect", "smooth", "warp"};
+    return names[stage];
+}
+
+// What the stabilizer measured while estimating one frame. Stages it did not
+// run are left negative and skipped.
+struct FrameMetrics {
+    size_t frame;
+    double stage_ms[METRIC_STAGE_COUNT];
+    int source_keypoints;  // keypoints handed to optical flow
+    int tracked_keypoints;
+    int inlier_keypoints;
+    double reprojection_error;  // mean over the RANSAC inliers, in estimation pixels
+    cv::Vec3d raw;
+    cv::Vec3d smoothed;
+
+    FrameMetrics() : frame(0), source_keypoints(0), tracked_keypoints(0), inlier_keypoints(0), reprojection_error(0) {
+        std::fill(stage_ms, stage_ms + METRIC_STAGE_COUNT, -1.0);
+    }
+};
+
+// Latency histogram over the last `window` samples with logarithmic bins
+// (20 per decade from 1 us to 10 s, about 12% wide). Adding a sample and
+// dropping the oldest one are O(1); percentiles scan the fixed bin array.
+class RollingHistogram {
+public:
+    explicit RollingHistogram(size_t window = 1000)
+        : counts(bin_count, 0), samples(std::max<size_t>(window, 1), 0), next(0), total(0) {}
+
+    void add(double ms) {
+        if (total == samples.size()) {
+            counts[samples[next]]--;
+        } else {
+            total++;
+        }
+        int bin = bin_of(ms);
+        samples[next] = static_cast<unsigned short>(bin);
+        counts[bin]++;
+        next = (next + 1) % samples.size();
+    }
+
+    // Latency below which a fraction `q` of the window falls, at bin resolution.
+    double percentile(double q) const {
+        if (total == 0) return 0.0;
+        size_t target = static_cast<size_t>(std::ceil(q * total));
+        size_t seen = 0;
+        for (int bin = 0; bin < bin_count; bin++) {
+            seen += counts[bin];
+            if (seen >= std::max<size_t>(target, 1)) {
+                return bin_centre(bin);
+            }
+        }
+        return bin_centre(bin_count - 1);
+    }
+
+    size_t size() const { return total; }
+
+private:
+    static const int bins_per_decade = 20;
+    static const int bin_count = 7 * bins_per_decade;  // 1e-3 .. 1e4 ms
+
+    static int bin_of(double ms) {
+        if (!(ms > 1e-3)) return 0;
+        int bin = static_cast<int>(std::log10(ms * 1e3) * bins_per_decade);
+        return std::min(bin, bin_count - 1);
+    }
+
+    static double bin_centre(int bin) {
+        return 1e-3 * std::pow(10.0, (bin + 0.5) / bins_per_decade);
+    }
+
+    std::vector<size_t> counts;
+    std::vector<unsigned short> samples;
+    size_t next;
+    size_t total;
+};
+
+// In-memory metrics for a stabilizer: rolling latency histograms per stage,
+// plus, when given a path, a background thread that appends every frame's
+// record to a JSON-lines file in batches. record() only copies the record
+// under a lock; formatting and file I/O happen on the writer thread, which
+// flushes once per batch. close() (or the destructor) drains the queue and
+// appends a summary line with the p50/p95/p99 of every stage and the overall
+// keypoint survival rate. Throws std::runtime_error if the file cannot be
+// opened.
+class MetricsRecorder {
+public:
+    explicit MetricsRecorder(const std::string& path = "", size_t window = 1000, size_t batch_size = 64)
+        : histograms(METRIC_STAGE_COUNT, RollingHistogram(window)), batch_size(std::max<size_t>(batch_size, 1)),
+          source_total(0), tracked_total(0), closed(false) {
+        if (!path.empty()) {
+            out.open(path.c_str());
+            if (!out) throw std::runtime_error("Cannot open metrics file for writing: " + path);
+            writer = std::thread(&MetricsRecorder::write_loop, this);
+        }
+    }
+
+    ~MetricsRecorder() {
+        close();
+    }
+
+    void record(const FrameMetrics& metrics) {
+        std::lock_guard<std::mutex> lock(mutex);
+        source_total += metrics.source_keypoints;
+        tracked_total += metrics.tracked_keypoints;
+        for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+            if (metrics.stage_ms[stage] >= 0) {
+                histograms[stage].add(metrics.stage_ms[stage]);
+            }
+        }
+        if (writer.joinable()) {
+            pending.push_back(metrics);
+            if (pending.size() >= batch_size) {
+                ready.notify_one();
+            }
+        }
+    }
+
+    // Latency of a stage that is not part of a frame record, e.g. the warp.
+    void record_stage(MetricStage stage, double ms) {
+        std::lock_guard<std::mutex> lock(mutex);
+        histograms[stage].add(ms);
+    }
+
+    double percentile(MetricStage stage, double q) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return histograms[stage].percentile(q);
+    }
+
+    // Fraction of the keypoints handed to optical flow that were tracked into
+    // the next frame, over all recorded frames.
+    double keypoint_survival() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return survival();
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed) return;
+            closed = true;
+        }
+        ready.notify_one();
+        if (writer.joinable()) {
+            writer.join();
+            out << summary_json() << "\n";
+            out.close();
+        }
+    }
+
+    // One JSON object with p50/p95/p99 in ms of every stage seen so far and
+    // the keypoint survival rate.
+    std::string summary_json() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream line;
+        line << "{\"summary\": {";
+        bool first = true;
+        for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+            const RollingHistogram& h = histograms[stage];
+            if (h.size() == 0) continue;
+            line << (first ? "" : ", ") << "\"" << metric_stage_name(stage) << "\": {\"samples\": " << h.size()
+                 << ", \"p50_ms\": " << h.percentile(0.5) << ", \"p95_ms\": " << h.percentile(0.95)
+                 << ", \"p99_ms\": " << h.percentile(0.99) << "}";
+            first = false;
+        }
+        line << "}, \"keypoint_survival\": " << survival() << "}";
+        return line.str();
+    }
+
+private:
+    double survival() const {
+        return source_total > 0 ? static_cast<double>(tracked_total) / source_total : 0.0;
+    }
+
+    void write_loop() {
+        std::vector<FrameMetrics> batch;
+        for (;;) {
+            bool done;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return closed || pending.size() >= batch_size; });
+                batch.swap(pending);
+                done = closed;
+            }
+            for (size_t i = 0; i < batch.size(); i++) {
+                write_line(batch[i]);
+            }
+            out.flush();
+            batch.clear();
+            if (done) return;
+        }
+    }
+
+    void write_line(const FrameMetrics& m) {
+        out << "{\"frame\": " << m.frame;
+        for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+            if (m.stage_ms[stage] >= 0) {
+                out << ", \"" << metric_stage_name(stage) << "_ms\": " << m.stage_ms[stage];
+            }
+        }
+        out << ", \"keypoints\": " << m.source_keypoints << ", \"tracked\": " << m.tracked_keypoints
+            << ", \"inliers\": " << m.inlier_keypoints << ", \"reprojection_px\": " << m.reprojection_error
+            << ", \"raw\": [" << m.raw[0] << ", " << m.raw[1] << ", " << m.raw[2] << "]"
+            << ", \"smoothed\": [" << m.smoothed[0] << ", " << m.smoothed[1] << ", " << m.smoothed[2] << "]}\n";
+    }
+
+    std::vector<RollingHistogram> histograms;
+    std::vector<FrameMetrics> pending;
+    size_t batch_size;
+    size_t source_total;
+    size_t tracked_total;
+    bool closed;
+
+    std::ofstream out;
+    std::thread writer;
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+};
+
+#endif // FRAME_METRICS_H
@@ -0,0 +1,56 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Recycles frame-sized Mat buffers, keyed by size and type.
+//
+// The pool keeps one reference to every buffer it has handed out. A buffer
+// is free again as soon as everybody else has dropped their Mat headers,
+// i.e. when the pool holds the only reference, so callers never release
+// anything explicitly. Once the pool holds as many buffers as the stabilizer
+// has in flight, acquire() stops allocating; allocations() counts the
+// buffers created so far and stays flat in steady state.
+class FramePool {
+public:
+    FramePool() : allocation_count(0) {}
+
+    cv::Mat acquire(cv::Size size, int type) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<cv::Mat>& buffers = pools[std::make_pair(type, std::make_pair(size.width, size.height))];
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (buffers[i].u && buffers[i].u->refcount == 1) {
+                return buffers[i];
+            }
+        }
+        buffers.push_back(cv::Mat(size, type));
+        allocation_count++;
+        return buffers.back();
+    }
+
+    // Pooled deep copy of `src`.
+    cv::Mat copy(const cv::Mat& src) {
+        cv::Mat dst = acquire(src.size(), src.type());
+        src.copyTo(dst);
+        return dst;
+    }
+
+    size_t allocations() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return allocation_count;
+    }
+
+private:
+    typedef std::pair<int, std::pair<int, int> > Key;
+
+    std::map<Key, std::vector<cv::Mat> > pools;
+    size_t allocation_count;
+    mutable std::mutex mutex;
+};
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,91 @@
+#ifndef FRAME_PREPROCESSOR_H
+#define FRAME_PREPROCESSOR_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <string>
+
+enum PreprocessMode {
+    PREPROCESS_OFF,        // track on the plain gray image
+    PREPROCESS_CLAHE,      // CLAHE on the estimation image
+    PREPROCESS_NORMALIZE   // global contrast stretch through a lookup table
+};
+
+// Parses "off", "clahe" or "normalize".
+inline bool parse_preprocess_mode(const std::string& name, PreprocessMode& mode) {
+    if (name == "off") mode = PREPROCESS_OFF;
+    else if (name == "clahe") mode = PREPROCESS_CLAHE;
+    else if (name == "normalize") mode = PREPROCESS_NORMALIZE;
+    else return false;
+    return true;
+}
+
+// Contrast preprocessing of the gray image the stabilizers estimate motion on.
+//
+// CLAHE works on whatever image it is given, so pairing it with a processing
+// resize (set_processing_max_dim) keeps it off the full-resolution frame. The
+// normalize mode is much cheaper: it builds a histogram from every 4th pixel
+// of every 4th row, stretches the 1st..99th percentile range to 0..255 and
+// applies that as a single LUT pass. It evens out exposure changes between
+// frames, which optical flow is sensitive to, but does not lift local
+// contrast the way CLAHE does.
+class FramePreprocessor {
+public:
+    explicit FramePreprocessor(PreprocessMode mode = PREPROCESS_CLAHE)
+        : mode(mode), clahe(cv::createCLAHE(2.0, cv::Size(8, 8))), lut(1, 256, CV_8UC1) {}
+
+    void set_mode(PreprocessMode mode) {
+        this->mode = mode;
+    }
+
+    PreprocessMode get_mode() const { return mode; }
+
+    // Preprocesses 8-bit `gray` in place.
+    void apply(cv::Mat& gray) {
+        switch (mode) {
+        case PREPROCESS_CLAHE:
+            clahe->apply(gray, gray);
+            break;
+        case PREPROCESS_NORMALIZE:
+            normalize_contrast(gray);
+            break;
+        case PREPROCESS_OFF:
+        default:
+            break;
+        }
+    }
+
+private:
+    void normalize_contrast(cv::Mat& gray) {
+        const int step = 4;
+        int histogram[256] = {0};
+        int samples = 0;
+        for (int y = 0; y < gray.rows; y += step) {
+            const uchar* row = gray.ptr<uchar>(y);
+            for (int x = 0; x < gray.cols; x += step) {
+                histogram[row[x]]++;
+                samples++;
+            }
+        }
+        if (samples == 0) return;
+
+        int low = 0, high = 255;
+        int clip = samples / 100;
+        for (int seen = 0; low < 255 && seen + histogram[low] <= clip; low++) seen += histogram[low];
+        for (int seen = 0; high > 0 && seen + histogram[high] <= clip; high--) seen += histogram[high];
+        // Nearly flat frames would only have their noise amplified
+        if (high - low < 8) return;
+
+        uchar* table = lut.ptr<uchar>();
+        for (int v = 0; v < 256; v++) {
+            table[v] = cv::saturate_cast<uchar>((v - low) * 255.0 / (high - low));
+        }
+        cv::LUT(gray, lut, gray);
+    }
+
+    PreprocessMode mode;
+    cv::Ptr<cv::CLAHE> clahe;
+    cv::Mat lut;
+};
+
+#endif // FRAME_PREPROCESSOR_H
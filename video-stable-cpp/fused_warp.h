@@ -0,0 +1,57 @@
+#ifndef FUSED_WARP_H
+#define FUSED_WARP_H
+
+#include <opencv2/imgproc.hpp>
+
+// Single-pass replacement for the copyMakeBorder -> warp -> ROI clone ->
+// crop_n_zoom resize chain in apply_transformations().
+//
+// All four steps are coordinate maps, so they compose into one 3x3 matrix
+// taking an output pixel to its source pixel in the original frame:
+//
+//     src = B^-1 * T^-1 * B * Z * dst
+//
+// where B shifts by the border size, T is the stabilizing transform in
+// bordered coordinates and Z is the crop_n_zoom resize (identity when
+// disabled). The frame is then sampled once, straight into an output of the
+// final size. With BORDER_CONSTANT the result matches the four-pass chain up
+// to interpolation; other border modes extrapolate from the frame edge
+// instead of from the padded copy, which only differs more than border_size
+// pixels outside the frame.
+
+// Output -> source map for a 2x3 (affine) or 3x3 (perspective) CV_64F transform.
+inline cv::Mat fused_warp_map(const cv::Mat& transform, cv::Size frame_size, int border_size, bool crop_n_zoom) {
+    cv::Mat forward = cv::Mat::eye(3, 3, CV_64F);
+    cv::Mat forward_rows = forward.rowRange(0, transform.rows);
+    transform.convertTo(forward_rows, CV_64F);
+
+    double b = border_size;
+    cv::Mat border_shift = (cv::Mat_<double>(3, 3) << 1, 0, b, 0, 1, b, 0, 0, 1);
+    cv::Mat border_unshift = (cv::Mat_<double>(3, 3) << 1, 0, -b, 0, 1, -b, 0, 0, 1);
+
+    // Same sampling grid as resize(INTER_LINEAR) from the cropped ROI.
+    cv::Mat zoom = cv::Mat::eye(3, 3, CV_64F);
+    if (crop_n_zoom) {
+        double sx = (frame_size.width - 2.0 * b) / frame_size.width;
+        double sy = (frame_size.height - 2.0 * b) / frame_size.height;
+        zoom = (cv::Mat_<double>(3, 3) << sx, 0, b + 0.5 * sx - 0.5, 0, sy, b + 0.5 * sy - 0.5, 0, 0, 1);
+    }
+
+    cv::Mat inverse_map = border_unshift * forward.inv() * border_shift * zoom;
+    return inverse_map;
+}
+
+// Warps `frame` into `output` (frame-sized) in one pass.
+inline void fused_warp(const cv::Mat& frame, cv::Mat& output, const cv::Mat& transform,
+                       int border_size, bool crop_n_zoom, int border_mode) {
+    cv::Mat inverse_map = fused_warp_map(transform, frame.size(), border_size, crop_n_zoom);
+    int flags = cv::INTER_LINEAR | cv::WARP_INVERSE_MAP;
+
+    if (transform.rows == 3) {
+        cv::warpPerspective(frame, output, inverse_map, frame.size(), flags, border_mode, cv::Scalar(0, 0, 0));
+    } else {
+        cv::warpAffine(frame, output, inverse_map.rowRange(0, 2), frame.size(), flags, border_mode, cv::Scalar(0, 0, 0));
+    }
+}
+
+#endif // FUSED_WARP_H
@@ -0,0 +1,114 @@
+#ifndef KEYPOINT_BUDGET_H
+#define KEYPOINT_BUDGET_H
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Frame-by-frame controller for the corner budget (maxCorners) and,
+// optionally, the LK pyramid depth of a stabilizer.
+//
+// update() takes what the last frame's estimation produced: RANSAC inliers,
+// the mean reprojection error of those inliers, and the wall time of the whole
+// estimation. These are smoothed with an exponential moving average so one
+// odd frame does not swing the budget. Then, in order of priority:
+//
+//   * over the time target: cut corners by 15%, and once at the minimum drop
+//     a pyramid level;
+//   * too few inliers or too large an error, with time to spare: add 20%
+//     more corners, and once at the maximum add a pyramid level (large
+//     motion is the usual reason tracks fail when corners are plentiful);
+//   * comfortably accurate: trim corners by 5% at a time, since every corner
+//     costs detection, flow and RANSAC time.
+class KeypointBudgetController {
+public:
+    KeypointBudgetController(int initial_corners, int min_corners, int max_corners, double target_ms,
+                             int min_inliers = 60, double max_error_px = 1.5)
+        : min_corners(std::max(min_corners, 1)), max_corners(std::max(max_corners, min_corners)),
+          target_ms(target_ms), min_inliers(min_inliers), max_error_px(max_error_px),
+          budget(std::min(std::max(static_cast<double>(initial_corners), static_cast<double>(min_corners)),
+                          static_cast<double>(max_corners))),
+          adapt_levels(false), min_levels(0), max_levels(0), levels(0),
+          mean_inliers(0), mean_error(0), mean_ms(0), samples(0) {}
+
+    // Also let the controller move the pyramid depth between min_levels and
+    // max_levels, starting from `initial_levels`.
+    void enable_pyramid_control(int initial_levels, int min_levels = 1, int max_levels = 5) {
+        adapt_levels = true;
+        this->min_levels = min_levels;
+        this->max_levels = std::max(max_levels, min_levels);
+        levels = std::min(std::max(initial_levels, this->min_levels), this->max_levels);
+    }
+
+    void update(int inliers, double reprojection_error, double estimation_ms) {
+        const double alpha = samples < 5 ? 0.5 : 0.2;
+        mean_inliers += alpha * (inliers - mean_inliers);
+        mean_error += alpha * (reprojection_error - mean_error);
+        mean_ms += alpha * (estimation_ms - mean_ms);
+        samples++;
+
+        bool accurate = mean_inliers >= min_inliers && mean_error <= max_error_px;
+        if (mean_ms > target_ms) {
+            if (budget > min_corners) {
+                budget = std::max(budget * 0.85, static_cast<double>(min_corners));
+            } else if (adapt_levels && levels > min_levels) {
+                levels--;
+            }
+        } else if (!accurate && mean_ms < 0.9 * target_ms) {
+            if (budget < max_corners) {
+                budget = std::min(budget * 1.2, static_cast<double>(max_corners));
+            } else if (adapt_levels && levels < max_levels) {
+                levels++;
+            }
+        } else if (accurate && mean_inliers >= 2 * min_inliers && mean_error <= 0.5 * max_error_px) {
+            budget = std::max(budget * 0.95, static_cast<double>(min_corners));
+        }
+    }
+
+    int corners() const { return static_cast<int>(std::lround(budget)); }
+
+    // LK pyramid levels to use; only meaningful with pyramid control enabled.
+    int pyramid_levels() const { return levels; }
+
+    bool controls_pyramid() const { return adapt_levels; }
+
+private:
+    int min_corners;
+    int max_corners;
+    double target_ms;
+    int min_inliers;
+    double max_error_px;
+
+    double budget;
+    bool adapt_levels;
+    int min_levels, max_levels, levels;
+
+    double mean_inliers, mean_error, mean_ms;
+    size_t samples;
+};
+
+// Mean distance, in pixels, between where the 2x3 affine or 3x3 homography
+// `transform` maps each inlier of `from` and its match in `to`. Zero when
+// there are no inliers.
+inline double mean_reprojection_error(const cv::Mat& transform, const std::vector<cv::Point2f>& from,
+                                      const std::vector<cv::Point2f>& to, const std::vector<uchar>& inlier_mask) {
+    if (transform.empty() || inlier_mask.size() != from.size()) return 0.0;
+    const double* m = transform.ptr<double>();
+    bool projective = transform.rows == 3;
+    double total = 0;
+    int count = 0;
+    for (size_t i = 0; i < from.size(); i++) {
+        if (!inlier_mask[i]) continue;
+        double w = projective ? m[6] * from[i].x + m[7] * from[i].y + m[8] : 1.0;
+        if (w == 0) continue;
+        double x = (m[0] * from[i].x + m[1] * from[i].y + m[2]) / w;
+        double y = (m[3] * from[i].x + m[4] * from[i].y + m[5]) / w;
+        total += std::sqrt((x - to[i].x) * (x - to[i].x) + (y - to[i].y) * (y - to[i].y));
+        count++;
+    }
+    return count > 0 ? total / count : 0.0;
+}
+
+#endif // KEYPOINT_BUDGET_H
@@ -0,0 +1,132 @@
+#ifndef KEYPOINT_DETECTOR_H
+#define KEYPOINT_DETECTOR_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "tiled_detector.h"
+
+// Corner detectors the stabilizers can track from. detect() returns at most
+// `max_corners` points of `gray`, only where `mask` is non-zero when a mask is
+// given, strongest first.
+class KeypointDetector {
+public:
+    virtual ~KeypointDetector() {}
+
+    virtual void detect(const cv::Mat& gray, std::vector<cv::Point2f>& corners, int max_corners,
+                        const cv::Mat& mask) = 0;
+};
+
+// goodFeaturesToTrack, optionally split over a grid of tiles detected in
+// parallel (see detect_tiled_corners).
+class GFTTKeypointDetector : public KeypointDetector {
+public:
+    GFTTKeypointDetector(double quality_level, double min_distance, cv::Size tiles = cv::Size())
+        : quality_level(quality_level), min_distance(min_distance), tiles(tiles) {}
+
+    void detect(const cv::Mat& gray, std::vector<cv::Point2f>& corners, int max_corners, const cv::Mat& mask) {
+        if (tiles.area() > 1) {
+            detect_tiled_corners(gray, corners, max_corners, quality_level, min_distance, mask, tiles);
+        } else {
+            cv::goodFeaturesToTrack(gray, corners, max_corners, quality_level, min_distance, mask, 3, false, 0.04);
+        }
+    }
+
+private:
+    double quality_level;
+    double min_distance;
+    cv::Size tiles;
+};
+
+// Any OpenCV Feature2D detector (FAST, ORB, ...). Its keypoints are taken by
+// decreasing response, skipping any that fall in a min_distance x min_distance
+// cell already holding a stronger one, so the points spread out much like
+// goodFeaturesToTrack's minimum distance without its O(n^2) check.
+class Feature2DKeypointDetector : public KeypointDetector {
+public:
+    Feature2DKeypointDetector(const cv::Ptr<cv::Feature2D>& detector, double min_distance)
+        : detector(detector), min_distance(std::max(min_distance, 1.0)) {}
+
+    void detect(const cv::Mat& gray, std::vector<cv::Point2f>& corners, int max_corners, const cv::Mat& mask) {
+        detector->detect(gray, keypoints, mask);
+        std::sort(keypoints.begin(), keypoints.end(), stronger);
+
+        int cols = static_cast<int>(gray.cols / min_distance) + 1;
+        int rows = static_cast<int>(gray.rows / min_distance) + 1;
+        occupied.assign(static_cast<size_t>(cols) * rows, false);
+
+        corners.clear();
+        for (size_t i = 0; i < keypoints.size() && static_cast<int>(corners.size()) < max_corners; i++) {
+            const cv::Point2f& pt = keypoints[i].pt;
+            size_t cell = static_cast<size_t>(pt.y / min_distance) * cols + static_cast<size_t>(pt.x / min_distance);
+            if (occupied[cell]) continue;
+            occupied[cell] = true;
+            corners.push_back(pt);
+        }
+    }
+
+private:
+    static bool stronger(const cv::KeyPoint& a, const cv::KeyPoint& b) {
+        return a.response > b.response;
+    }
+
+    cv::Ptr<cv::Feature2D> detector;
+    double min_distance;
+    std::vector<cv::KeyPoint> keypoints;
+    std::vector<bool> occupied;
+};
+
+// ORB through Feature2DKeypointDetector. ORB itself keeps only its best
+// nfeatures keypoints, so nfeatures follows the max_corners of each call;
+// a new budget is a setter call, not a new detector.
+class ORBKeypointDetector : public Feature2DKeypointDetector {
+public:
+    ORBKeypointDetector(const cv::Ptr<cv::ORB>& orb, double min_distance)
+        : Feature2DKeypointDetector(orb, min_distance), orb(orb) {}
+
+    void detect(const cv::Mat& gray, std::vector<cv::Point2f>& corners, int max_corners, const cv::Mat& mask) {
+        if (orb->getMaxFeatures() != max_corners) orb->setMaxFeatures(max_corners);
+        Feature2DKeypointDetector::detect(gray, corners, max_corners, mask);
+    }
+
+private:
+    cv::Ptr<cv::ORB> orb;
+};
+
+enum DetectorType {
+    DETECTOR_GFTT,
+    DETECTOR_FAST,
+    DETECTOR_ORB
+};
+
+// Detector of `type` with a stabilizer's goodFeaturesToTrack settings.
+// `tiles` only applies to GFTT; quality_level has no FAST or ORB equivalent.
+// max_corners is only ORB's initial nfeatures: every detector takes the
+// budget through detect(), so a new budget needs no new detector.
+inline cv::Ptr<KeypointDetector> create_keypoint_detector(DetectorType type, int max_corners, double quality_level,
+                                                          double min_distance, cv::Size tiles = cv::Size()) {
+    switch (type) {
+    case DETECTOR_FAST:
+        return cv::makePtr<Feature2DKeypointDetector>(cv::FastFeatureDetector::create(20, true), min_distance);
+    case DETECTOR_ORB:
+        return cv::makePtr<ORBKeypointDetector>(cv::ORB::create(max_corners), min_distance);
+    case DETECTOR_GFTT:
+    default:
+        return cv::makePtr<GFTTKeypointDetector>(quality_level, min_distance, tiles);
+    }
+}
+
+// Parses "gftt", "fast" or "orb".
+inline bool parse_detector_type(const std::string& name, DetectorType& type) {
+    if (name == "gftt") type = DETECTOR_GFTT;
+    else if (name == "fast") type = DETECTOR_FAST;
+    else if (name == "orb") type = DETECTOR_ORB;
+    else return false;
+    return true;
+}
+
+#endif // KEYPOINT_DETECTOR_H
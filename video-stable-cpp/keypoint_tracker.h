@@ -0,0 +1,133 @@
+#ifndef KEYPOINT_TRACKER_H
+#define KEYPOINT_TRACKER_H
+
+#include <opencv2/imgproc.hpp>
+#include <cstddef>
+#include <vector>
+
+#include "keypoint_detector.h"
+
+// Owns the corner detector of a stabilizer (goodFeaturesToTrack unless
+// set_detector() picks another one) and decides when corners have to be
+// detected again.
+//
+// With tracking disabled every update() re-detects over the whole frame, which
+// is what the stabilizers always did. With tracking enabled the points that
+// survived optical flow are carried forward as the next frame's keypoints, and
+// detection only runs once fewer than `redetect_ratio` of the last detected set
+// are left. Re-detection can be limited to the areas that lost their features,
+// keeping the surviving tracks. With tiling enabled every detection is split
+// over a grid of tiles that run in parallel (see detect_tiled_corners).
+class KeypointTracker {
+public:
+    KeypointTracker(int max_corners, double quality_level, double min_distance)
+        : max_corners(max_corners), quality_level(quality_level), min_distance(min_distance),
+          tracking(false), redetect_ratio(0.5), redetect_lost_regions(true), tiles(0, 0),
+          detector_type(DETECTOR_GFTT), detected_count(0), frame_count(0), detection_count(0) {
+        detector = create_keypoint_detector(detector_type, max_corners, quality_level, min_distance, tiles);
+    }
+
+    void enable_tracking(double redetect_ratio = 0.5, bool redetect_lost_regions = true) {
+        tracking = true;
+        this->redetect_ratio = redetect_ratio;
+        this->redetect_lost_regions = redetect_lost_regions;
+    }
+
+    // Detect in a grid of cols x rows tiles, each with an equal share of
+    // max_corners. A 1x1 grid (or 0x0) goes back to plain goodFeaturesToTrack.
+    // Only used by the GFTT detector.
+    void enable_tiling(int cols, int rows) {
+        tiles = cv::Size(cols, rows);
+        detector = create_keypoint_detector(detector_type, max_corners, quality_level, min_distance, tiles);
+    }
+
+    // New corner budget, used from the next detection on. Tracked points are
+    // kept even if there are more of them. Cheap enough to call every frame:
+    // the detector gets the budget with each detect() call.
+    void set_max_corners(int max_corners) {
+        this->max_corners = max_corners;
+    }
+
+    int get_max_corners() const { return max_corners; }
+
+    void set_detector(DetectorType type) {
+        detector_type = type;
+        detector = create_keypoint_detector(detector_type, max_corners, quality_level, min_distance, tiles);
+    }
+
+    // Full-frame detection, used for the first frame.
+    void detect(const cv::Mat& gray, std::vector<cv::Point2f>& keypoints) {
+        frame_count++;
+        detect_all(gray, keypoints);
+    }
+
+    // `keypoints` holds the points successfully tracked into `gray` and is
+    // replaced by the keypoints to track from `gray` into the next frame.
+    void update(const cv::Mat& gray, std::vector<cv::Point2f>& keypoints) {
+        frame_count++;
+
+        if (!tracking) {
+            detect_all(gray, keypoints);
+            return;
+        }
+
+        if (!keypoints.empty() && keypoints.size() >= redetect_ratio * detected_count) {
+            return;
+        }
+
+        if (!redetect_lost_regions || keypoints.empty()) {
+            detect_all(gray, keypoints);
+            return;
+        }
+
+        // Only look for new corners away from the tracks that are still alive.
+        mask.create(gray.size(), CV_8UC1);
+        mask.setTo(cv::Scalar(255));
+        for (size_t i = 0; i < keypoints.size(); i++) {
+            cv::circle(mask, keypoints[i], static_cast<int>(min_distance), cv::Scalar(0), -1);
+        }
+
+        int missing = max_corners - static_cast<int>(keypoints.size());
+        if (missing > 0) {
+            std::vector<cv::Point2f> fresh;
+            detector->detect(gray, fresh, missing, mask);
+            keypoints.insert(keypoints.end(), fresh.begin(), fresh.end());
+        }
+        detected_count = keypoints.size();
+        detection_count++;
+    }
+
+    // Fraction of frames on which the detector ran.
+    double detection_frequency() const {
+        return frame_count > 0 ? static_cast<double>(detection_count) / frame_count : 0.0;
+    }
+
+    size_t frames() const { return frame_count; }
+    size_t detections() const { return detection_count; }
+
+private:
+    void detect_all(const cv::Mat& gray, std::vector<cv::Point2f>& keypoints) {
+        detector->detect(gray, keypoints, max_corners, cv::Mat());
+        detected_count = keypoints.size();
+        detection_count++;
+    }
+
+    int max_corners;
+    double quality_level;
+    double min_distance;
+
+    bool tracking;
+    double redetect_ratio;
+    bool redetect_lost_regions;
+    cv::Size tiles;
+    DetectorType detector_type;
+    cv::Ptr<KeypointDetector> detector;
+
+    cv::Mat mask;
+
+    size_t detected_count;
+    size_t frame_count;
+    size_t detection_count;
+};
+
+#endif // KEYPOINT_TRACKER_H
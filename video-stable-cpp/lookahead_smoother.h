@@ -0,0 +1,73 @@
+#ifndef LOOKAHEAD_SMOOTHER_H
+#define LOOKAHEAD_SMOOTHER_H
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+
+#include "ring_queue.h"
+
+// Trajectory smoothing with a fixed, small lookahead, so that output latency
+// does not grow with smoothing strength.
+//
+// The camera trajectory (cumulative dx, dy, da) of every frame is pushed as it
+// is estimated. The smoothed position of a frame is a least-squares line
+// through the trajectory over `history` frames up to and including it plus
+// whatever future frames are available, at most `lookahead`, evaluated at
+// that frame. A line rather than a plain mean means a steady pan is followed
+// without lag even with zero lookahead; only the shake around it is removed.
+// A longer history smooths harder without delaying the output.
+class LookaheadSmoother {
+public:
+    LookaheadSmoother(int history, int lookahead)
+        : history(std::max(history, 1)), lookahead(std::max(lookahead, 0)) {}
+
+    void reset() {
+        trajectory.clear();
+    }
+
+    void push(const cv::Vec3d& position) {
+        trajectory.push_back(position);
+        if (trajectory.size() > static_cast<size_t>(history + lookahead)) {
+            trajectory.pop_front();
+        }
+    }
+
+    // Frames of future the smoother waits for before a frame is output.
+    int delay() const { return lookahead; }
+
+    // Offset (dx, dy, da) that moves the frame `ahead` frames before the newest
+    // one onto the smoothed trajectory.
+    cv::Vec3d correction(int ahead) const {
+        int newest = static_cast<int>(trajectory.size()) - 1;
+        int t = newest - ahead;
+        if (t < 0) return cv::Vec3d(0, 0, 0);
+
+        int first = std::max(0, t - history + 1);
+        double n = 0, sx = 0, sxx = 0;
+        cv::Vec3d sy(0, 0, 0), sxy(0, 0, 0);
+        for (int i = first; i <= newest; i++) {
+            double x = i - t;
+            n += 1;
+            sx += x;
+            sxx += x * x;
+            sy += trajectory[i];
+            sxy += x * trajectory[i];
+        }
+
+        // Intercept of the fitted line, i.e. its value at frame t
+        cv::Vec3d smoothed = sy * (1.0 / n);
+        double denominator = n * sxx - sx * sx;
+        if (denominator > 1e-9) {
+            cv::Vec3d slope = (n * sxy - sx * sy) * (1.0 / denominator);
+            smoothed = (sy - sx * slope) * (1.0 / n);
+        }
+        return smoothed - trajectory[t];
+    }
+
+private:
+    int history;
+    int lookahead;
+    RingQueue<cv::Vec3d> trajectory;
+};
+
+#endif // LOOKAHEAD_SMOOTHER_H
@@ -9,8 +9,32 @@
 #include <numeric>
 #include <thread>
 #include <mutex>
-#include <fstream>
 #include <future>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+#include "keypoint_tracker.h"
+#include "keypoint_budget.h"
+#include "prosac_estimator.h"
+#include "pyramid_cache.h"
+#include "processing_resize.h"
+#include "fused_warp.h"
+#include "frame_pool.h"
+#include "ring_queue.h"
+#include "trajectory_smoother.h"
+#include "lookahead_smoother.h"
+#include "frame_preprocessor.h"
+#include "frame_metrics.h"
+#include "deadline_controller.h"
+
+#include "bounded_queue.h"
+#include "reorder_buffer.h"
+#include "transform_file.h"
 
 using namespace cv;
 using namespace std;
@@ -19,7 +43,13 @@ class Stabilizer {
 public:
     Stabilizer(int smoothing_radius = 25, string border_type = "black", int border_size = 0, bool crop_n_zoom = false, 
                bool logging = false, double process_noise_cov = 1e-3, double measurement_noise_cov = 1e-1)
-        : smoothing_radius(smoothing_radius), border_size(border_size), crop_n_zoom(crop_n_zoom), logging(logging) {
+        : smoothing_radius(smoothing_radius), border_size(border_size), crop_n_zoom(crop_n_zoom), logging(logging),
+          keypoint_tracker(750, 0.05, 30.0), motion_estimator(ESTIMATOR_RANSAC), processing_max_dim(0),
+          estimation_scale(1.0), use_fused_warp(false),
+          estimation_started(false), process_noise_cov(process_noise_cov), measurement_noise_cov(measurement_noise_cov),
+          stream_started(false), retain_frames(true), output_latency(1000), estimated_frames(0), degradation(DEGRADE_NONE), frame_dropped(false),
+          active_max_dim(0),
+          realtime_full_corners(0), estimation_resync(false) {
 
         if (border_type == "black") border_mode = BORDER_CONSTANT;
         else if (border_type == "reflect") border_mode = BORDER_REFLECT;
@@ -28,167 +58,497 @@ public:
         else if (border_type == "wrap") border_mode = BORDER_WRAP;
         else border_mode = BORDER_CONSTANT;
 
-        clahe = createCLAHE(2.0, Size(8, 8));
+        // Kalman smoothing unless set_smoother() picks another one
+        set_smoother(SMOOTHER_KALMAN);
 
-        // Initialize Kalman filter
-        kalman.init(6, 3, 0);
-        kalman.transitionMatrix = (Mat_<float>(6, 6) <<
-            1, 0, 0, 1, 0, 0,
-            0, 1, 0, 0, 1, 0,
-            0, 0, 1, 0, 0, 1,
-            0, 0, 0, 1, 0, 0,
-            0, 0, 0, 0, 1, 0,
-            0, 0, 0, 0, 0, 1);
+        if (logging) {
+            enable_metrics("stabilizer_metrics.jsonl");
+        }
+    }
 
-        kalman.measurementMatrix = Mat::eye(3, 6, CV_32F);
+    // Carry tracked keypoints forward instead of re-detecting every frame;
+    // corners are detected again once fewer than redetect_ratio of them survive.
+    void enable_keypoint_tracking(double redetect_ratio = 0.5, bool redetect_lost_regions = true) {
+        keypoint_tracker.enable_tracking(redetect_ratio, redetect_lost_regions);
+    }
 
-        // Increase Kalman filter coefficients for stronger smoothing
-        setIdentity(kalman.processNoiseCov, Scalar::all(process_noise_cov)); 
-        setIdentity(kalman.measurementNoiseCov, Scalar::all(measurement_noise_cov)); 
-        setIdentity(kalman.errorCovPost, Scalar::all(1)); // Initial error covariance
+    // Spread corner detection over a cols x rows grid of tiles, detected in
+    // parallel with an equal share of corners each, for even coverage.
+    void enable_tiled_detection(int cols = 4, int rows = 4) {
+        keypoint_tracker.enable_tiling(cols, rows);
+    }
 
-        if (logging) {
-            log_file.open("stabilizer_log.txt");
-        }
+    // Contrast preprocessing of the estimation image: CLAHE (the default),
+    // a cheap global normalization, or none for well-lit footage.
+    void set_preprocessing(PreprocessMode mode) {
+        preprocessor.set_mode(mode);
     }
 
-    ~Stabilizer() {
-        if (logging) {
-            log_file.close();
+    // Track FAST or ORB corners instead of goodFeaturesToTrack.
+    void set_detector(DetectorType type) {
+        keypoint_tracker.set_detector(type);
+    }
+
+    // Let the corner budget follow tracking quality and time: keep estimation
+    // under target_ms per frame with between min_corners and max_corners
+    // corners, and with adapt_pyramid also move the LK pyramid depth.
+    // See KeypointBudgetController.
+    void enable_adaptive_budget(double target_ms, int min_corners, int max_corners, bool adapt_pyramid = false) {
+        keypoint_budget = makePtr<KeypointBudgetController>(keypoint_tracker.get_max_corners(), min_corners,
+                                                            max_corners, target_ms);
+        if (adapt_pyramid) {
+            keypoint_budget->enable_pyramid_control(pyramid_cache.get_max_level());
         }
     }
 
+    // Current corner budget.
+    int corner_budget() const {
+        return keypoint_tracker.get_max_corners();
+    }
+
+    // Robust estimator for the frame-to-frame motion: OpenCV's RANSAC (the
+    // default) or a PROSAC-style similarity fit that samples the matches with
+    // the lowest LK error first and stops early (estimate_similarity_prosac).
+    void set_motion_estimator(MotionEstimator estimator) {
+        motion_estimator = estimator;
+    }
+
+    // Fraction of frames that ran keypoint detection.
+    double detection_frequency() const {
+        return keypoint_tracker.detection_frequency();
+    }
+
+    // Estimate motion on a copy of the frame whose longest side is at most
+    // max_dim pixels. Output frames keep the input resolution. Call before
+    // the first frame.
+    void set_processing_max_dim(int max_dim) {
+        processing_max_dim = max_dim;
+        active_max_dim = max_dim;
+    }
+
+    // Produce output frames with a single warp straight to the final size
+    // instead of border, warp, ROI copy and crop_n_zoom resize.
+    void set_fused_warp(bool enabled) {
+        use_fused_warp = enabled;
+    }
+
+    // Record per-frame stage latencies, keypoint counts and transforms, with
+    // rolling p50/p95/p99 latencies. With a path, every frame is also
+    // appended to it as a JSON line by a background writer; throws if the
+    // file cannot be opened.
+    void enable_metrics(const string& path = "") {
+        metrics = makePtr<MetricsRecorder>(path);
+    }
+
+    // Null unless enable_metrics() was called.
+    MetricsRecorder* metrics_recorder() const {
+        return metrics.get();
+    }
+
+    // Live mode: keep each frame within deadline_ms, timing all of
+    // stabilize(), or estimate() alone when the caller warps separately as
+    // the headless and pipeline modes do. When the deadline is at risk it
+    // steps through the DegradationLevel settings: half the corners, a
+    // smaller estimation image, the smoother's prediction instead of
+    // estimation, and finally dropping frames (stabilize() then returns an
+    // empty Mat, estimate() false). Dropped frames never come out, so this
+    // does not combine with set_retain_frames(false). Call before the first
+    // frame.
+    void enable_realtime(double deadline_ms) {
+        deadline = makePtr<DeadlineController>(deadline_ms);
+        realtime_full_corners = keypoint_tracker.get_max_corners();
+    }
+
+    // Null unless enable_realtime() was called.
+    DeadlineController* deadline_controller() const {
+        return deadline.get();
+    }
+
+    // Smoother applied to the estimated motion; the Kalman filter uses the
+    // noise covariances given to the constructor. Call before the first frame.
+    void set_smoother(SmootherType type) {
+        smoother = create_trajectory_smoother(type, smoothing_radius, process_noise_cov, measurement_noise_cov);
+    }
+
+    // Low-latency output: instead of holding smoothing_radius frames, output
+    // each frame once `frames` newer ones have been estimated (0 for a purely
+    // causal filter). Frames are moved onto a line fitted through the last
+    // smoothing_radius positions of the camera trajectory plus the lookahead
+    // (see LookaheadSmoother), so the window stays long while the latency
+    // stays small. A negative value restores the default. Call before the
+    // first frame.
+    void set_lookahead(int frames) {
+        lookahead = frames >= 0 ? makePtr<LookaheadSmoother>(smoothing_radius, frames) : Ptr<LookaheadSmoother>();
+    }
+
+    // Memory-lean mode for file input: the lookahead keeps only transforms,
+    // not frames. estimate() and flush() then hand back an empty pending
+    // frame and the caller decodes the frame due for output itself; frames
+    // come out in input order, so a second reader trailing the first one
+    // will do (see stabilize_to_writer_lean). stabilize(), the pipeline and
+    // stabilize_to_writer() need the frames and refuse a lean stabilizer.
+    // Call before the first frame.
+    void set_retain_frames(bool retain) {
+        retain_frames = retain;
+    }
+
+    bool retains_frames() const {
+        return retain_frames;
+    }
+
+    // Frames held back before output in the current mode.
+    int output_delay_frames() const {
+        return lookahead ? lookahead->delay() : smoothing_radius;
+    }
+
+    // Wall time from a frame entering estimate() (or stabilize()) to its
+    // transform being handed out, over the last 1000 frames.
+    double output_latency_ms(double q) const {
+        return output_latency.percentile(q);
+    }
+
     Mat stabilize(const Mat& frame) {
         if (frame.empty()) return Mat();
+        if (!retain_frames) throw runtime_error("stabilize() needs the frames, which lean mode does not keep");
 
         lock_guard<mutex> lock(frame_queue_mutex);
-        if (frame_queue.empty()) {
-            initialize(frame);
-            return frame;
-        } else if (frame_queue.size() < smoothing_radius) {
-            frame_queue.push_back(frame);
-            generate_transformations(frame);
-            return frame;
+        int64 start = getTickCount();
+        Mat pending_frame, transform;
+        bool ready = estimate_frame(frame, pending_frame, transform, false);
+        if (frame_dropped) return Mat();
+        if (ready) stabilized_frame = warp(pending_frame, transform);
+        if (deadline) deadline->report(elapsed_ms(start));
+        return ready ? stabilized_frame : frame;
+    }
+
+    // Motion-estimation half of stabilize(). Once the lookahead is full, hands
+    // back the frame that is due for output together with its transform.
+    // With frame_owned the caller promises never to write to `frame`'s buffer
+    // again (e.g. a fresh decoder buffer per frame), so it is queued as is
+    // instead of being copied. In real-time mode this is where frames are
+    // degraded or dropped, so every caller keeps to the deadline.
+    bool estimate(const Mat& frame, Mat& pending_frame, Mat& transform, bool frame_owned = false) {
+        int64 start = getTickCount();
+        bool ready = estimate_frame(frame, pending_frame, transform, frame_owned);
+        if (deadline && !frame_dropped) deadline->report(elapsed_ms(start));
+        return ready;
+    }
+
+    // Drains the lookahead at end of stream, one frame per call. Once it is
+    // empty the next frame starts a new stream.
+    //
+    // Without set_lookahead() a frame is warped with the smoother's output
+    // from smoothing_radius frames later, which the drained frames never
+    // get. Each of them steps the smoother on by its prediction instead, so
+    // the tail keeps following the trajectory rather than all sharing the
+    // last frame's correction.
+    bool flush(Mat& pending_frame, Mat& transform) {
+        if (!lookahead && !frame_queue.empty()) {
+            smoothed_transform = smoother->predict();
+        }
+        if (next_transformation(pending_frame, transform)) return true;
+        stream_started = false;
+        return false;
+    }
+
+    // Raw motion of `frame` relative to the previous frame, without any
+    // smoothing or lookahead; used by the offline passes. The first frame
+    // of a sequence has zero motion.
+    Vec3d measure_motion(const Mat& frame) {
+        if (!estimation_started) {
+            start_estimation(frame);
+            return Vec3d(0, 0, 0);
+        }
+        return estimate_motion(frame);
+    }
+
+    // 3x3 matrix for a (dx, dy, da) transform, as taken by warp().
+    static Mat transform_matrix(const Vec3d& t) {
+        Mat matrix(3, 3, CV_64F);
+        write_transform_matrix(t, matrix);
+        return matrix;
+    }
+
+    // transform_matrix() into an existing 3x3 CV_64F buffer.
+    static void write_transform_matrix(const Vec3d& t, Mat& matrix) {
+        double* m = matrix.ptr<double>();
+        m[0] = cos(t[2]); m[1] = -sin(t[2]); m[2] = t[0];
+        m[3] = sin(t[2]); m[4] = cos(t[2]);  m[5] = t[1];
+        m[6] = 0;         m[7] = 0;          m[8] = 1;
+    }
+
+    // Warp half of stabilize(). Touches no estimator state, so it can run on
+    // another thread while the next frames are being estimated.
+    Mat warp(const Mat& frame, const Mat& transform) const {
+        int64 start = getTickCount();
+        Mat result = frame_pool.acquire(frame.size(), frame.type());
+        if (use_fused_warp) {
+            fused_warp(frame, result, transform, border_size, crop_n_zoom, border_mode);
         } else {
-            frame_queue.push_back(frame);
-            generate_transformations(frame);
-            apply_transformations();
-            return stabilized_frame;
+            warp_in_steps(frame, transform, result);
+        }
+        if (metrics) {
+            metrics->record_stage(STAGE_WARP, elapsed_ms(start));
         }
+        return result;
     }
 
+    // Pooled buffers (queued frames, estimation images, warp buffers, output
+    // frames and transforms) allocated so far; constant once warmed up.
+    // Allocations inside OpenCV calls such as calcOpticalFlowPyrLK and
+    // findHomography are not counted.
+    size_t buffer_allocations() const {
+        return frame_pool.allocations();
+    }
 
 private:
-    void initialize(const Mat& frame) {
-        Mat gray;
-        cvtColor(frame, gray, COLOR_BGR2GRAY);
-        clahe->apply(gray, gray);
-        goodFeaturesToTrack(gray, previous_keypoints, 750, 0.05, 30.0, Mat(), 3, false, 0.04);
-        frame_height = frame.rows;
-        clahe->apply(gray, gray);
-        frame_width = frame.cols;
-        frame_queue.push_back(frame);
-        previous_gray = gray.clone();
+    static double elapsed_ms(int64 start) {
+        return (getTickCount() - start) * 1000.0 / getTickFrequency();
+    }
+
+    // estimate() without the deadline timing, which stabilize() extends over
+    // the warp. Sets frame_dropped when real-time mode skips the frame.
+    bool estimate_frame(const Mat& frame, Mat& pending_frame, Mat& transform, bool frame_owned) {
+        frame_dropped = false;
+        degradation = deadline ? deadline->next_level() : DEGRADE_NONE;
+        if (degradation == DEGRADE_DROP && stream_started) {
+            deadline->report_dropped();
+            estimation_resync = true;
+            frame_dropped = true;
+            return false;
+        }
+
+        if (!stream_started) {
+            initialize(frame, frame_owned);
+        } else {
+            enqueue(frame, frame_owned);
+            generate_transformations(frame);
+        }
+        if (frame_queue.size() <= static_cast<size_t>(output_delay_frames())) {
+            return false;
+        }
 
-        // Initialize Kalman state
-        kalman.statePost = (Mat_<float>(6, 1) << 0, 0, 0, 0, 0, 0);
+        // The oldest frame goes out with exactly output_delay_frames() newer
+        // ones behind it, so with lookahead k it is corrected with k future
+        // trajectory samples, and with k = 0 it is the frame that just came in
+        CV_Assert(frame_queue.size() == static_cast<size_t>(output_delay_frames()) + 1);
+        return next_transformation(pending_frame, transform);
     }
 
-    void generate_transformations(const Mat& frame) {
-        Mat gray;
-        cvtColor(frame, gray, COLOR_BGR2GRAY);
-        clahe->apply(gray, gray);
+    void warp_in_steps(const Mat& frame, const Mat& transform, Mat& result) const {
 
-        vector<Point2f> curr_kps;
-        vector<uchar> status;
-        vector<float> err;
-        TermCriteria termcrit(TermCriteria::COUNT | TermCriteria::EPS, 20, 0.03);
-        calcOpticalFlowPyrLK(previous_gray, gray, previous_keypoints, curr_kps, status, err, Size(31, 31), 3, termcrit, 0, 0.001);
+        Mat bordered_frame = frame_pool.acquire(Size(frame.cols + 2 * border_size, frame.rows + 2 * border_size), frame.type());
+        copyMakeBorder(frame, bordered_frame, border_size, border_size, border_size, border_size, border_mode, Scalar(0, 0, 0));
 
-        vector<Point2f> valid_curr_kps, valid_previous_keypoints;
-        for (size_t i = 0; i < status.size(); i++) {
-            if (status[i]) {
-                valid_curr_kps.push_back(curr_kps[i]);
-                valid_previous_keypoints.push_back(previous_keypoints[i]);
-            }
-        }
+        Mat frame_wrapped = frame_pool.acquire(bordered_frame.size(), frame.type());
+        warpPerspective(bordered_frame, frame_wrapped, transform, bordered_frame.size(), INTER_LINEAR, border_mode, Scalar(0, 0, 0));
 
-        Mat transformation;
-        if (valid_curr_kps.size() >= 4 && valid_previous_keypoints.size() >= 4) {
-            transformation = findHomography(valid_previous_keypoints, valid_curr_kps, RANSAC);
+        if (crop_n_zoom) {
+            // Inner crop of the frame area, which starts border_size into the warped buffer
+            Rect roi(2 * border_size, 2 * border_size, frame.cols - 2 * border_size, frame.rows - 2 * border_size);
+            resize(frame_wrapped(roi), result, frame.size(), 0, 0, INTER_LINEAR);
         } else {
-            transformation = Mat::eye(3, 3, CV_64F);
+            frame_wrapped(Rect(border_size, border_size, frame.cols, frame.rows)).copyTo(result);
         }
+    }
 
-        double dx = transformation.at<double>(0, 2);
-        double dy = transformation.at<double>(1, 2);
-        double da = atan2(transformation.at<double>(1, 0), transformation.at<double>(0, 0));
+    void initialize(const Mat& frame, bool frame_owned) {
+        start_estimation(frame);
+        enqueue(frame, frame_owned);
+        stream_started = true;
 
-        Vec3d frame_transform(dx, dy, da);
-        transforms.push_back(frame_transform);
+        smoother->reset();
+        smoothed_transform = Vec3d(0, 0, 0);
+        trajectory = Vec3d(0, 0, 0);
+        if (lookahead) {
+            lookahead->reset();
+            lookahead->push(trajectory);
+        }
+    }
 
-        if (transforms.size() > smoothing_radius) {
-            transforms.pop_front();
+    // Own the frame so the caller can reuse its buffer for the next read,
+    // unless it was handed over. Lean mode only queues a placeholder.
+    void enqueue(const Mat& frame, bool frame_owned) {
+        if (!retain_frames) frame_queue.push_back(Mat());
+        else frame_queue.push_back(frame_owned ? frame : frame_pool.copy(frame));
+        arrival_ticks.push_back(getTickCount());
+    }
+
+    void start_estimation(const Mat& frame) {
+        estimation_scale = processing_scale(frame.size(), active_max_dim);
+        Mat gray = estimation_gray(frame);
+        preprocessor.apply(gray);
+        keypoint_tracker.detect(gray, previous_keypoints);
+        frame_height = frame.rows;
+        frame_width = frame.cols;
+        pyramid_cache.reset(gray);
+        estimation_started = true;
+    }
+
+    void generate_transformations(const Mat& frame) {
+        if (deadline) {
+            apply_degradation(frame);
+        }
+        // Frames that skip estimation break the optical-flow chain, so the
+        // first frame estimated after them starts a new one and also takes the
+        // prediction.
+        if (degradation >= DEGRADE_PREDICT || estimation_resync) {
+            if (degradation < DEGRADE_PREDICT) {
+                start_estimation(frame);
+                estimation_resync = false;
+            } else {
+                estimation_resync = true;
+            }
+            smoothed_transform = smoother->predict();
+            if (lookahead) {
+                trajectory += smoothed_transform;
+                lookahead->push(trajectory);
+            }
+            return;
         }
 
-        goodFeaturesToTrack(gray, previous_keypoints, 750, 0.05, 30.0, Mat(), 3, false, 0.04);
-        previous_gray = gray.clone();
+        Vec3d frame_transform = estimate_motion(frame);
 
-        // Update Kalman filter
-        Mat measurement = (Mat_<float>(3, 1) << dx, dy, da);
-        kalman.correct(measurement);
+        int64 start = getTickCount();
+        smoothed_transform = smoother->update(frame_transform);
+        if (lookahead) {
+            trajectory += frame_transform;
+            lookahead->push(trajectory);
+        }
+        frame_metrics.stage_ms[STAGE_SMOOTH] = elapsed_ms(start);
 
-        if (logging) {
-            log_file << "Transformation: dx = " << dx << ", dy = " << dy << ", da = " << da << endl;
+        if (metrics) {
+            frame_metrics.raw = frame_transform;
+            frame_metrics.smoothed = smoothed_transform;
+            metrics->record(frame_metrics);
         }
     }
 
-    void apply_transformations() {
-        Mat frame = frame_queue.front();
-        frame_queue.pop_front();
+    // Corner budget and estimation image size for the current degradation
+    // level. A new size takes effect through a resync.
+    void apply_degradation(const Mat& frame) {
+        int corners = keypoint_budget ? keypoint_budget->corners() : realtime_full_corners;
+        keypoint_tracker.set_max_corners(degradation >= DEGRADE_FEWER_FEATURES ? max(corners / 2, 1) : corners);
 
-        // Predict using Kalman filter
-        Mat prediction = kalman.predict();
-        double dx = prediction.at<float>(0);
-        double dy = prediction.at<float>(1);
-        double da = prediction.at<float>(2);
+        int max_dim = processing_max_dim;
+        if (degradation >= DEGRADE_LOWER_RESOLUTION) {
+            int full_dim = max(frame.cols, frame.rows);
+            if (processing_max_dim > 0) full_dim = min(full_dim, processing_max_dim);
+            max_dim = max(full_dim / 2, 160);
+        }
+        if (max_dim != active_max_dim) {
+            active_max_dim = max_dim;
+            estimation_resync = true;
+        }
+    }
 
-        // Apply average of previous transformations
-        Vec3d avg_transform = average_transform();
-        dx += avg_transform[0];
-        dy += avg_transform[1];
-        da += avg_transform[2];
+    // Frame-to-frame motion (dx, dy, da) of `frame` relative to the previous one.
+    Vec3d estimate_motion(const Mat& frame) {
+        frame_metrics = FrameMetrics();
+        frame_metrics.frame = estimated_frames++;
+        int64 estimation_start = getTickCount();
 
-        Mat transform = (Mat_<double>(3, 3) << cos(da), -sin(da), dx, sin(da), cos(da), dy, 0, 0, 1);
+        int64 start = getTickCount();
+        Mat gray = estimation_gray(frame);
+        frame_metrics.stage_ms[STAGE_GRAY] = elapsed_ms(start);
 
-        Mat bordered_frame;
-        copyMakeBorder(frame, bordered_frame, border_size, border_size, border_size, border_size, border_mode, Scalar(0, 0, 0));
+        start = getTickCount();
+        preprocessor.apply(gray);
+        frame_metrics.stage_ms[STAGE_PREPROCESS] = elapsed_ms(start);
 
-        Mat frame_wrapped;
-        warpPerspective(bordered_frame, frame_wrapped, transform, bordered_frame.size(), INTER_LINEAR, border_mode, Scalar(0, 0, 0));
+        start = getTickCount();
+        TermCriteria termcrit(TermCriteria::COUNT | TermCriteria::EPS, 20, 0.03);
+        pyramid_cache.track(gray, previous_keypoints, curr_kps, status, err, termcrit, 0, 0.001);
+        frame_metrics.stage_ms[STAGE_OPTICAL_FLOW] = elapsed_ms(start);
 
-        stabilized_frame = frame_wrapped(Rect(border_size, border_size, frame_width, frame_height)).clone();
+        valid_curr_kps.clear();
+        valid_previous_keypoints.clear();
+        valid_err.clear();
+        for (size_t i = 0; i < status.size(); i++) {
+            if (status[i]) {
+                valid_curr_kps.push_back(curr_kps[i]);
+                valid_previous_keypoints.push_back(previous_keypoints[i]);
+                valid_err.push_back(err[i]);
+            }
+        }
 
-        if (crop_n_zoom) {
-            Rect roi(border_size, border_size, frame_width - 2 * border_size, frame_height - 2 * border_size);
-            Mat frame_cropped = stabilized_frame(roi);
-            resize(frame_cropped, stabilized_frame, Size(frame_width, frame_height), 0, 0, INTER_LINEAR);
+        start = getTickCount();
+        // Identity unless an estimator finds the motion; reuses its buffer
+        // except where findHomography returns a new one
+        transformation.create(3, 3, CV_64F);
+        setIdentity(transformation);
+        if (valid_curr_kps.size() >= 4 && valid_previous_keypoints.size() >= 4) {
+            if (motion_estimator == ESTIMATOR_PROSAC) {
+                Similarity similarity;
+                if (estimate_similarity_prosac(valid_previous_keypoints, valid_curr_kps, valid_err, inlier_mask,
+                                               similarity)) {
+                    similarity.write(transformation);
+                }
+            } else {
+                Mat homography = findHomography(valid_previous_keypoints, valid_curr_kps, RANSAC, 3, inlier_mask);
+                if (!homography.empty()) transformation = homography;
+            }
+            frame_metrics.inlier_keypoints = countNonZero(inlier_mask);
+            frame_metrics.reprojection_error = mean_reprojection_error(transformation, valid_previous_keypoints,
+                                                                       valid_curr_kps, inlier_mask);
         }
+        frame_metrics.stage_ms[STAGE_RANSAC] = elapsed_ms(start);
+        frame_metrics.source_keypoints = static_cast<int>(previous_keypoints.size());
+        frame_metrics.tracked_keypoints = static_cast<int>(valid_curr_kps.size());
 
-        if (logging) {
-            log_file << "Applied transformation: dx = " << dx << ", dy = " << dy << ", da = " << da << endl;
+        // Translation back to full-resolution pixels; rotation is scale-free
+        double dx = transformation.at<double>(0, 2) / estimation_scale;
+        double dy = transformation.at<double>(1, 2) / estimation_scale;
+        double da = atan2(transformation.at<double>(1, 0), transformation.at<double>(0, 0));
+
+        start = getTickCount();
+        previous_keypoints.swap(valid_curr_kps);
+        keypoint_tracker.update(gray, previous_keypoints);
+        frame_metrics.stage_ms[STAGE_DETECT] = elapsed_ms(start);
+
+        if (keypoint_budget) {
+            keypoint_budget->update(frame_metrics.inlier_keypoints, frame_metrics.reprojection_error, elapsed_ms(estimation_start));
+            keypoint_tracker.set_max_corners(keypoint_budget->corners());
+            if (keypoint_budget->controls_pyramid()) {
+                pyramid_cache.set_max_level(keypoint_budget->pyramid_levels());
+            }
         }
+
+        return Vec3d(dx, dy, da);
     }
 
-    Vec3d average_transform() {
-        double sum_dx = 0, sum_dy = 0, sum_da = 0;
-        for (const Vec3d& trans : transforms) {
-            sum_dx += trans[0];
-            sum_dy += trans[1];
-            sum_da += trans[2];
+    // Gray and possibly downscaled copy of `frame` for motion estimation, in
+    // pooled buffers. The caller runs the preprocessor on it.
+    Mat estimation_gray(const Mat& frame) {
+        Mat gray = frame_pool.acquire(frame.size(), CV_8UC1);
+        cvtColor(frame, gray, COLOR_BGR2GRAY);
+        if (estimation_scale != 1.0) {
+            Mat resized = frame_pool.acquire(processing_size(frame.size(), estimation_scale), CV_8UC1);
+            resize_for_processing(gray, resized);
+            gray = resized;
         }
-        int n = transforms.size();
-        return Vec3d(sum_dx / n, sum_dy / n, sum_da / n);
+        return gray;
+    }
+
+    bool next_transformation(Mat& pending_frame, Mat& transform) {
+        if (frame_queue.empty()) return false;
+
+        pending_frame = frame_queue.front();
+        // Pooled, since the pipeline may still be warping with earlier ones
+        transform = frame_pool.acquire(Size(3, 3), CV_64F);
+        if (lookahead) {
+            // Future samples available for this frame: its lookahead, fewer
+            // while flushing
+            int ahead = static_cast<int>(frame_queue.size()) - 1;
+            write_transform_matrix(lookahead->correction(ahead), transform);
+        } else {
+            write_transform_matrix(smoothed_transform, transform);
+        }
+        frame_queue.pop_front();
+
+        output_latency.add(elapsed_ms(arrival_ticks.front()));
+        arrival_ticks.pop_front();
+        return true;
     }
 
     int smoothing_radius;
@@ -196,31 +556,748 @@ private:
     bool crop_n_zoom;
     bool logging;
     int border_mode;
-    Ptr<CLAHE> clahe;
-    deque<Mat> frame_queue;
-    deque<Vec3d> transforms;
-    Mat previous_gray;
+    FramePreprocessor preprocessor;
+    RingQueue<Mat> frame_queue;
+    RingQueue<int64> arrival_ticks;  // when each frame_queue entry arrived
+    PyramidCache pyramid_cache;
     vector<Point2f> previous_keypoints;
+    // Per-frame scratch, kept to reuse capacity
+    vector<Point2f> curr_kps, valid_curr_kps, valid_previous_keypoints;
+    vector<uchar> status;
+    vector<float> err;
+    vector<float> valid_err;
+    vector<uchar> inlier_mask;
+    Mat transformation;
+    mutable FramePool frame_pool;
+    KeypointTracker keypoint_tracker;
+    MotionEstimator motion_estimator;
+    Ptr<KeypointBudgetController> keypoint_budget;
+    int processing_max_dim;
+    double estimation_scale;
+    bool use_fused_warp;
+    bool estimation_started;
     int frame_height, frame_width;
     Mat stabilized_frame;
 
-    // Kalman filter
-    KalmanFilter kalman;
+    // Motion smoothing
+    double process_noise_cov, measurement_noise_cov;
+    Ptr<TrajectorySmoother> smoother;
+    Vec3d smoothed_transform;
+
+    // Low-latency and memory-lean output
+    bool stream_started;  // a frame has been queued since construction or the last flush
+    bool retain_frames;
+    Ptr<LookaheadSmoother> lookahead;
+    Vec3d trajectory;
+    RollingHistogram output_latency;
 
     // Mutex for thread safety
     mutex frame_queue_mutex;
 
-    // Logging
-    ofstream log_file;
+    // Observability
+    Ptr<MetricsRecorder> metrics;
+    FrameMetrics frame_metrics;
+    size_t estimated_frames;
+
+    // Real-time mode
+    Ptr<DeadlineController> deadline;
+    DegradationLevel degradation;
+    bool frame_dropped;
+    int active_max_dim;  // processing_max_dim, or less while degraded
+    int realtime_full_corners;
+    bool estimation_resync;
+};
+
+// Runs a Stabilizer as four overlapping stages: decode -> motion estimation ->
+// warp -> encode. Stages are joined by bounded queues and each stage is a
+// single thread consuming its queue in order, so the output sequence is
+// deterministic and identical to what stabilize() produces, minus the
+// unstabilized warm-up frames.
+class StabilizerPipeline {
+public:
+    // Receives (original, stabilized) pairs; return false to stop early.
+    typedef function<bool(const Mat&, const Mat&)> FrameSink;
+
+    StabilizerPipeline(Stabilizer& stabilizer, size_t queue_capacity = 4)
+        : stabilizer(stabilizer), decoded(queue_capacity), estimated(queue_capacity), warped(queue_capacity) {}
+
+    // Reads `cap` to the end, then drains the lookahead and every queue before
+    // returning. The sink runs on the calling thread as the encode stage.
+    // Returns the number of frames handed to the sink.
+    size_t run(VideoCapture& cap, const FrameSink& sink) {
+        if (!stabilizer.retains_frames()) {
+            throw runtime_error("the pipeline warps queued frames, which lean mode does not keep");
+        }
+        thread decoder([this, &cap] { guarded([this, &cap] { decode_stage(cap); }); });
+        thread estimator([this] { guarded([this] { estimate_stage(); }); });
+        thread warper([this] { guarded([this] { warp_stage(); }); });
+
+        size_t frames_written = 0;
+        guarded([this, &sink, &frames_written] { frames_written = encode_stage(sink); });
+
+        // No-op after a normal drain; unblocks the other stages on early exit.
+        cancel();
+        decoder.join();
+        estimator.join();
+        warper.join();
+
+        if (error) rethrow_exception(error);
+        return frames_written;
+    }
+
+private:
+    struct PipelineFrame {
+        Mat frame;
+        Mat transform;
+        Mat stabilized;
+    };
+
+    void decode_stage(VideoCapture& cap) {
+        Size size;
+        int type = 0;
+        while (true) {
+            // Separate buffer per frame: the decoded queue still holds earlier ones.
+            Mat frame;
+            if (!size.empty()) frame = decode_pool.acquire(size, type);
+            if (!cap.read(frame) || frame.empty()) break;
+            size = frame.size();
+            type = frame.type();
+            if (!decoded.push(frame)) return;
+        }
+        decoded.close();
+    }
+
+    void estimate_stage() {
+        Mat frame;
+        PipelineFrame item;
+        while (decoded.pop(frame)) {
+            if (stabilizer.estimate(frame, item.frame, item.transform, true)) {
+                if (!estimated.push(item)) return;
+            }
+        }
+        while (stabilizer.flush(item.frame, item.transform)) {
+            if (!estimated.push(item)) return;
+        }
+        estimated.close();
+    }
+
+    void warp_stage() {
+        PipelineFrame item;
+        while (estimated.pop(item)) {
+            item.stabilized = stabilizer.warp(item.frame, item.transform);
+            if (!warped.push(item)) return;
+        }
+        warped.close();
+    }
+
+    size_t encode_stage(const FrameSink& sink) {
+        size_t frames_written = 0;
+        PipelineFrame item;
+        while (warped.pop(item)) {
+            frames_written++;
+            if (!sink(item.frame, item.stabilized)) break;
+        }
+        return frames_written;
+    }
+
+    void guarded(const function<void()>& stage) {
+        try {
+            stage();
+        } catch (...) {
+            {
+                lock_guard<mutex> lock(error_mutex);
+                if (!error) error = current_exception();
+            }
+            cancel();
+        }
+    }
+
+    void cancel() {
+        decoded.close();
+        estimated.close();
+        warped.close();
+    }
+
+    Stabilizer& stabilizer;
+    FramePool decode_pool;
+    BoundedQueue<Mat> decoded;
+    BoundedQueue<PipelineFrame> estimated;
+    BoundedQueue<PipelineFrame> warped;
+
+    mutex error_mutex;
+    exception_ptr error;
+};
+
+// Hosts many independent streams in one process. Each stream keeps its own
+// capture, Stabilizer and sink, and a light decoder thread that reads ahead
+// into a small bounded queue. All estimation, warping and sink calls run on
+// one shared pool of worker threads.
+//
+// Streams with a decoded frame wait in a FIFO ready queue. A worker takes the
+// stream at the head, processes exactly one frame and, if more work is
+// pending, puts the stream back at the tail, so streams are served round-robin
+// one frame at a time and a busy feed cannot starve the others. A stream is
+// never in the ready queue twice, so its frames stay in order on a
+// single-threaded Stabilizer without extra locking.
+class MultiStreamRunner {
+public:
+    // Receives (original, stabilized) pairs; return false to stop the stream.
+    typedef function<bool(const Mat&, const Mat&)> FrameSink;
+
+    struct StreamStats {
+        string source;
+        double source_fps;       // CAP_PROP_FPS of the capture, 0 if unknown
+        size_t frames_read;
+        size_t frames_written;
+        double busy_seconds;     // worker time spent on this stream
+        double elapsed_seconds;  // from run() start to the stream's last frame
+        string error;            // set if the stream stopped on an exception
+
+        double fps() const {
+            return elapsed_seconds > 0 ? frames_written / elapsed_seconds : 0.0;
+        }
+    };
+
+    MultiStreamRunner(unsigned workers, size_t queue_capacity = 2)
+        : workers(workers > 0 ? workers : 1), queue_capacity(queue_capacity), finished_streams(0) {}
+
+    // Camera index or file path, as on the command line.
+    void add_stream(const string& source, int smoothing_radius, const function<void(Stabilizer&)>& configure,
+                    const FrameSink& sink) {
+        streams.push_back(unique_ptr<Stream>(new Stream(source, smoothing_radius, queue_capacity, sink)));
+        configure(streams.back()->stabilizer);
+    }
+
+    // Processes every stream to its end (or until its sink declines a frame).
+    void run() {
+        // The pool is the parallelism; OpenCV's own threads would only compete with it
+        int opencv_threads = getNumThreads();
+        setNumThreads(1);
+
+        run_start = chrono::steady_clock::now();
+        finished_streams = 0;
+        vector<thread> decoders;
+        for (size_t id = 0; id < streams.size(); id++) {
+            decoders.push_back(thread([this, id] { decode(id); }));
+        }
+        vector<thread> pool;
+        for (unsigned i = 0; i < workers; i++) {
+            pool.push_back(thread([this] { work(); }));
+        }
+
+        for (size_t i = 0; i < pool.size(); i++) pool[i].join();
+        for (size_t i = 0; i < decoders.size(); i++) decoders[i].join();
+        setNumThreads(opencv_threads);
+    }
+
+    // Frame rate the stream's capture reports, 0 until it is open or if it
+    // reports none. Set before the stream's first frame reaches its sink.
+    double source_fps(size_t id) const {
+        lock_guard<mutex> lock(schedule_mutex);
+        return streams[id]->stats.source_fps;
+    }
+
+    vector<StreamStats> stats() const {
+        lock_guard<mutex> lock(schedule_mutex);
+        vector<StreamStats> result;
+        for (size_t id = 0; id < streams.size(); id++) {
+            result.push_back(streams[id]->stats);
+        }
+        return result;
+    }
+
+private:
+    struct Stream {
+        Stream(const string& source, int smoothing_radius, size_t queue_capacity, const FrameSink& sink)
+            : source(source), stabilizer(smoothing_radius), decoded(queue_capacity), sink(sink),
+              scheduled(false), end_of_input(false), finished(false) {
+            stats.source = source;
+            stats.source_fps = 0;
+            stats.frames_read = stats.frames_written = 0;
+            stats.busy_seconds = stats.elapsed_seconds = 0;
+        }
+
+        string source;
+        VideoCapture cap;
+        Stabilizer stabilizer;
+        FramePool decode_pool;
+        BoundedQueue<Mat> decoded;
+        FrameSink sink;
+
+        // Guarded by schedule_mutex
+        bool scheduled;
+        bool end_of_input;
+        bool finished;
+        StreamStats stats;
+    };
+
+    void decode(size_t id) {
+        Stream& stream = *streams[id];
+        if (isdigit(stream.source[0])) stream.cap.open(stoi(stream.source));
+        else stream.cap.open(stream.source);
+        {
+            lock_guard<mutex> lock(schedule_mutex);
+            if (stream.cap.isOpened()) stream.stats.source_fps = stream.cap.get(CAP_PROP_FPS);
+            else stream.stats.error = "Error opening video source";
+        }
+
+        Size size;
+        int type = 0;
+        size_t frames_read = 0;
+        while (stream.cap.isOpened()) {
+            Mat frame;
+            if (!size.empty()) frame = stream.decode_pool.acquire(size, type);
+            if (!stream.cap.read(frame) || frame.empty()) break;
+            size = frame.size();
+            type = frame.type();
+            if (!stream.decoded.push(frame)) break;
+            frames_read++;
+            make_ready(id, false, frames_read);
+        }
+        make_ready(id, true, frames_read);
+    }
+
+    // Called by the decoder after each frame and once at end of input.
+    void make_ready(size_t id, bool end_of_input, size_t frames_read) {
+        lock_guard<mutex> lock(schedule_mutex);
+        Stream& stream = *streams[id];
+        stream.stats.frames_read = frames_read;
+        stream.end_of_input = stream.end_of_input || end_of_input;
+        if (!stream.scheduled && !stream.finished) {
+            stream.scheduled = true;
+            ready.push_back(id);
+            work_available.notify_one();
+        }
+    }
+
+    void work() {
+        while (true) {
+            size_t id;
+            {
+                unique_lock<mutex> lock(schedule_mutex);
+                work_available.wait(lock, [this] { return !ready.empty() || finished_streams == streams.size(); });
+                if (ready.empty()) return;
+                id = ready.front();
+                ready.pop_front();
+            }
+
+            Stream& stream = *streams[id];
+            auto start = chrono::steady_clock::now();
+            bool done = false;
+            string error;
+            try {
+                done = process_one(stream);
+            } catch (const exception& e) {
+                error = e.what();
+                done = true;
+            }
+            auto end = chrono::steady_clock::now();
+
+            lock_guard<mutex> lock(schedule_mutex);
+            stream.stats.busy_seconds += chrono::duration<double>(end - start).count();
+            stream.stats.elapsed_seconds = chrono::duration<double>(end - run_start).count();
+            if (!error.empty()) stream.stats.error = error;
+
+            // Decided under the lock: a decoder that pushes after this check
+            // sees scheduled == false and queues the stream itself.
+            if (done) {
+                stream.finished = true;
+                stream.scheduled = false;
+                stream.decoded.close();
+                finished_streams++;
+                work_available.notify_all();
+            } else if (stream.decoded.size() > 0 || stream.end_of_input) {
+                ready.push_back(id);
+                work_available.notify_one();
+            } else {
+                stream.scheduled = false;
+            }
+        }
+    }
+
+    // One frame of work: estimate and warp the next decoded frame, or drain
+    // one frame of lookahead once the input has ended. Returns true when the
+    // stream is complete.
+    bool process_one(Stream& stream) {
+        Mat pending_frame, transform;
+        if (stream.decoded.size() > 0) {
+            Mat frame;
+            stream.decoded.pop(frame);
+            if (!stream.stabilizer.estimate(frame, pending_frame, transform, true)) return false;
+        } else {
+            {
+                lock_guard<mutex> lock(schedule_mutex);
+                if (!stream.end_of_input) return false;
+            }
+            if (!stream.stabilizer.flush(pending_frame, transform)) return true;
+        }
+
+        Mat stabilized = stream.stabilizer.warp(pending_frame, transform);
+        bool more = stream.sink(pending_frame, stabilized);
+        {
+            lock_guard<mutex> lock(schedule_mutex);
+            stream.stats.frames_written++;
+        }
+        return !more;
+    }
+
+    unsigned workers;
+    size_t queue_capacity;
+    vector<unique_ptr<Stream> > streams;
+
+    mutable mutex schedule_mutex;
+    condition_variable work_available;
+    deque<size_t> ready;
+    size_t finished_streams;
+    chrono::steady_clock::time_point run_start;
 };
 
+// Offline pass one: raw motion of every frame in `cap`, followed by the
+// trajectory and its smoothed version over the whole file.
+vector<TransformRecord> generate_transforms(VideoCapture& cap, Stabilizer& stabilizer, int smoothing_window, Size& frame_size) {
+    vector<TransformRecord> records;
+    Mat frame;
+    while (cap.read(frame) && !frame.empty()) {
+        frame_size = frame.size();
+        TransformRecord record;
+        record.raw = stabilizer.measure_motion(frame);
+        records.push_back(record);
+    }
+    smooth_trajectory(records, smoothing_window);
+    return records;
+}
+
+// Segment-parallel version of pass one for long files. The input is split
+// into `segments` equal frame ranges, each estimated on its own thread with
+// its own capture and Stabilizer (and therefore its own pyramid and
+// keypoints). Every segment after the first starts decoding one frame early;
+// that overlap frame bridges the boundary, so the raw transforms concatenate
+// into one global sequence that is smoothed as a whole.
+//
+// That only holds if CAP_PROP_FRAME_COUNT is exact and every seek lands on
+// the frame asked for, which many backends and containers do not guarantee
+// (estimated counts, seeks to the nearest keyframe). Each segment checks
+// where its seek landed and that it decoded its whole range; if any segment
+// cannot, the file is estimated again in a single sequential pass instead.
+vector<TransformRecord> generate_transforms_segmented(const string& source, int segments,
+                                                      const function<void(Stabilizer&)>& configure,
+                                                      int smoothing_window, Size& frame_size) {
+    VideoCapture probe(source);
+    long frame_count = probe.isOpened() ? static_cast<long>(probe.get(CAP_PROP_FRAME_COUNT)) : 0;
+    probe.release();
+
+    segments = static_cast<int>(min<long>(max(segments, 1), max(frame_count / 2, 1L)));
+    vector<vector<TransformRecord> > segment_records(segments);
+    vector<Size> segment_sizes(segments);
+    vector<char> segment_exact(segments, 1);
+
+    mutex error_mutex;
+    exception_ptr error;
+
+    vector<thread> workers;
+    for (int k = 0; k < segments; k++) {
+        workers.push_back(thread([&, k] {
+            try {
+                long start = frame_count * k / segments;
+                long end = frame_count * (k + 1) / segments;
+                bool last = k == segments - 1;
+
+                VideoCapture cap(source);
+                if (!cap.isOpened()) throw runtime_error("Error opening video source for segment " + to_string(k));
+
+                Stabilizer estimator(smoothing_window);
+                configure(estimator);
+
+                long overlap = start > 0 ? 1 : 0;
+                if (start > 0) {
+                    cap.set(CAP_PROP_POS_FRAMES, static_cast<double>(start - overlap));
+                    if (static_cast<long>(cap.get(CAP_PROP_POS_FRAMES)) != start - overlap) {
+                        segment_exact[k] = 0;
+                        return;
+                    }
+                }
+
+                Mat frame;
+                long i = start - overlap;
+                for (; last || i < end; i++) {
+                    if (!cap.read(frame) || frame.empty()) break;
+                    TransformRecord record;
+                    record.raw = estimator.measure_motion(frame);
+                    if (i >= start) segment_records[k].push_back(record);
+                    segment_sizes[k] = frame.size();
+                }
+                // A short segment means the frame count was overestimated
+                // and the next segment's frames do not follow on from this one
+                if ((!last && i < end) || segment_records[k].size() != static_cast<size_t>(max(i - start, 0L))) {
+                    segment_exact[k] = 0;
+                }
+            } catch (...) {
+                lock_guard<mutex> lock(error_mutex);
+                if (!error) error = current_exception();
+            }
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++) workers[k].join();
+    if (error) rethrow_exception(error);
+
+    if (find(segment_exact.begin(), segment_exact.end(), 0) != segment_exact.end()) {
+        cerr << "Warning: " << source << " does not seek frame-accurately; estimating it in one pass" << endl;
+        VideoCapture cap(source);
+        if (!cap.isOpened()) throw runtime_error("Error opening video source");
+        Stabilizer estimator(smoothing_window);
+        configure(estimator);
+        return generate_transforms(cap, estimator, smoothing_window, frame_size);
+    }
+
+    vector<TransformRecord> records;
+    for (int k = 0; k < segments; k++) {
+        records.insert(records.end(), segment_records[k].begin(), segment_records[k].end());
+        if (!segment_sizes[k].empty()) frame_size = segment_sizes[k];
+    }
+    smooth_trajectory(records, smoothing_window);
+    return records;
+}
+
+// Offline pass two: decodes `cap` on one thread, warps each frame with its
+// stored correction on `threads` workers and writes the results in input
+// order through a reorder buffer. Returns the number of frames written.
+size_t apply_transforms(VideoCapture& cap, const Stabilizer& stabilizer, const vector<TransformRecord>& records,
+                        VideoWriter& writer, unsigned threads) {
+    struct WarpJob {
+        size_t index;
+        Mat frame;
+    };
+
+    threads = max(1u, threads);
+    BoundedQueue<WarpJob> jobs(2 * threads);
+    ReorderBuffer<Mat> output(2 * threads);
+
+    mutex error_mutex;
+    exception_ptr error;
+    auto fail = [&]() {
+        {
+            lock_guard<mutex> lock(error_mutex);
+            if (!error) error = current_exception();
+        }
+        jobs.close();
+        output.close();
+    };
+
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.push_back(thread([&] {
+            try {
+                WarpJob job;
+                while (jobs.pop(job)) {
+                    Mat transform = Stabilizer::transform_matrix(records[job.index].correction());
+                    if (!output.push(job.index, stabilizer.warp(job.frame, transform))) return;
+                }
+            } catch (...) {
+                fail();
+            }
+        }));
+    }
+
+    FramePool decode_pool;
+    thread decoder([&] {
+        try {
+            Size size;
+            int type = 0;
+            for (size_t i = 0; i < records.size(); i++) {
+                WarpJob job;
+                job.index = i;
+                if (!size.empty()) job.frame = decode_pool.acquire(size, type);
+                if (!cap.read(job.frame) || job.frame.empty()) break;
+                size = job.frame.size();
+                type = job.frame.type();
+                if (!jobs.push(job)) break;
+            }
+        } catch (...) {
+            fail();
+        }
+        jobs.close();
+        for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+        output.close();
+    });
+
+    size_t frames_written = 0;
+    try {
+        Mat stabilized;
+        while (output.pop(stabilized)) {
+            writer.write(stabilized);
+            frames_written++;
+        }
+    } catch (...) {
+        fail();
+    }
+    decoder.join();
+
+    if (error) rethrow_exception(error);
+    return frames_written;
+}
+
+// Headless batch mode: stabilizes every frame of `cap` into `writer`,
+// including the lookahead still queued at end of stream. Returns the number
+// of frames written, which equals the number of frames read less any that
+// real-time mode dropped.
+size_t stabilize_to_writer(VideoCapture& cap, Stabilizer& stabilizer, VideoWriter& writer) {
+    if (!stabilizer.retains_frames()) {
+        throw runtime_error("lean mode has to re-decode its frames; use stabilize_to_writer_lean");
+    }
+    Mat frame, pending_frame, transform;
+    size_t frames_written = 0;
+    while (cap.read(frame)) {
+        if (stabilizer.estimate(frame, pending_frame, transform)) {
+            writer.write(stabilizer.warp(pending_frame, transform));
+            frames_written++;
+        }
+    }
+    while (stabilizer.flush(pending_frame, transform)) {
+        writer.write(stabilizer.warp(pending_frame, transform));
+        frames_written++;
+    }
+    return frames_written;
+}
+
+// stabilize_to_writer() with a Stabilizer in memory-lean mode: `cap` feeds
+// the estimator while a second reader on `source` decodes every frame again,
+// in step with the output, for the warp. Each frame is decoded twice, but at
+// most a couple of frames are resident however long the lookahead is.
+size_t stabilize_to_writer_lean(VideoCapture& cap, const string& source, Stabilizer& stabilizer,
+                                VideoWriter& writer) {
+    if (stabilizer.deadline_controller()) {
+        throw runtime_error("real-time mode drops frames, which the re-decoding reader cannot follow");
+    }
+    VideoCapture trailing(source);
+    if (!trailing.isOpened()) {
+        throw runtime_error("cannot reopen " + source + " to re-decode frames for output");
+    }
+
+    stabilizer.set_retain_frames(false);
+    Mat frame, output_frame, pending_frame, transform;
+    size_t frames_written = 0;
+    while (cap.read(frame)) {
+        if (stabilizer.estimate(frame, pending_frame, transform)) {
+            if (!trailing.read(output_frame)) break;
+            writer.write(stabilizer.warp(output_frame, transform));
+            frames_written++;
+        }
+    }
+    while (stabilizer.flush(pending_frame, transform) && trailing.read(output_frame)) {
+        writer.write(stabilizer.warp(output_frame, transform));
+        frames_written++;
+    }
+    return frames_written;
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <video_file>" << endl;
+        cerr << "Usage: " << argv[0] << " <video_file> [--headless --output OUT [--codec FOURCC] [--lean]]"
+             << " [--stream SOURCE ...] [--pipeline] [--track] [--detector gftt|fast|orb] [--tiles CxR]"
+             << " [--max-dim N] [--preprocess off|clahe|normalize] [--fused-warp]"
+             << " [--budget-ms MS [--adaptive-pyramid]] [--realtime DEADLINE_MS] [--lookahead K]"
+             << " [--smoother average|gaussian|kalman] [--estimator ransac|prosac] [--metrics FILE]"
+             << " [--gen-transforms FILE [--segments N]] [--apply-transforms FILE --output OUT [--codec FOURCC]] [--threads N]" << endl;
         return -1;
     }
 
     string source = argv[1];
+    bool pipeline_mode = false;
+    bool headless = false;
+    bool lean = false;
+    string codec = "MJPG";
+    bool track_keypoints = false;
+    DetectorType detector = DETECTOR_GFTT;
+    PreprocessMode preprocess = PREPROCESS_CLAHE;
+    double budget_ms = 0;
+    bool adaptive_pyramid = false;
+    double realtime_deadline_ms = 0;
+    int lookahead = -1;
+    int tile_cols = 0, tile_rows = 0;
+    int processing_max_dim = 0;
+    bool fused = false;
+    int smoothing_radius = 25;
+    SmootherType smoother = SMOOTHER_KALMAN;
+    MotionEstimator estimator = ESTIMATOR_RANSAC;
+    string metrics_path;
+    vector<string> extra_streams;
+    string gen_transforms_path, apply_transforms_path, output_path;
+    unsigned threads = thread::hardware_concurrency();
+    int segments = 1;
+    for (int i = 2; i < argc; i++) {
+        if (string(argv[i]) == "--pipeline") pipeline_mode = true;
+        else if (string(argv[i]) == "--headless") headless = true;
+        else if (string(argv[i]) == "--lean") lean = true;
+        else if (string(argv[i]) == "--stream" && i + 1 < argc) extra_streams.push_back(argv[++i]);
+        else if (string(argv[i]) == "--codec" && i + 1 < argc) codec = argv[++i];
+        else if (string(argv[i]) == "--track") track_keypoints = true;
+        else if (string(argv[i]) == "--detector" && i + 1 < argc) {
+            if (!parse_detector_type(argv[++i], detector)) {
+                cerr << "Unknown detector: " << argv[i] << endl;
+                return -1;
+            }
+        }
+        else if (string(argv[i]) == "--preprocess" && i + 1 < argc) {
+            if (!parse_preprocess_mode(argv[++i], preprocess)) {
+                cerr << "Unknown preprocessing mode: " << argv[i] << endl;
+                return -1;
+            }
+        }
+        else if (string(argv[i]) == "--budget-ms" && i + 1 < argc) budget_ms = stod(argv[++i]);
+        else if (string(argv[i]) == "--adaptive-pyramid") adaptive_pyramid = true;
+        else if (string(argv[i]) == "--realtime" && i + 1 < argc) realtime_deadline_ms = stod(argv[++i]);
+        else if (string(argv[i]) == "--lookahead" && i + 1 < argc) lookahead = stoi(argv[++i]);
+        else if (string(argv[i]) == "--tiles" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &tile_cols, &tile_rows) != 2) {
+                cerr << "Expected --tiles COLSxROWS, got: " << argv[i] << endl;
+                return -1;
+            }
+        }
+        else if (string(argv[i]) == "--max-dim" && i + 1 < argc) processing_max_dim = stoi(argv[++i]);
+        else if (string(argv[i]) == "--fused-warp") fused = true;
+        else if (string(argv[i]) == "--smoother" && i + 1 < argc) {
+            if (!parse_smoother_type(argv[++i], smoother)) {
+                cerr << "Unknown smoother: " << argv[i] << endl;
+                return -1;
+            }
+        }
+        else if (string(argv[i]) == "--estimator" && i + 1 < argc) {
+            if (!parse_motion_estimator(argv[++i], estimator)) {
+                cerr << "Unknown estimator: " << argv[i] << endl;
+                return -1;
+            }
+        }
+        else if (string(argv[i]) == "--gen-transforms" && i + 1 < argc) gen_transforms_path = argv[++i];
+        else if (string(argv[i]) == "--apply-transforms" && i + 1 < argc) apply_transforms_path = argv[++i];
+        else if (string(argv[i]) == "--metrics" && i + 1 < argc) metrics_path = argv[++i];
+        else if (string(argv[i]) == "--output" && i + 1 < argc) output_path = argv[++i];
+        else if (string(argv[i]) == "--threads" && i + 1 < argc) threads = stoi(argv[++i]);
+        else if (string(argv[i]) == "--segments" && i + 1 < argc) segments = stoi(argv[++i]);
+    }
+
+    // Every mode that writes video encodes with --codec
+    if (codec.size() != 4) {
+        cerr << "--codec must be four characters" << endl;
+        return -1;
+    }
+    int fourcc = VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]);
+
+    // --lean re-decodes the input for a writer; every other mode warps the
+    // frames it keeps
+    if (lean && (!headless || pipeline_mode || !extra_streams.empty() || !gen_transforms_path.empty() ||
+                 !apply_transforms_path.empty())) {
+        cerr << "--lean only works with --headless, and not with --pipeline, --stream or the transform passes" << endl;
+        return -1;
+    }
+
+    // Only estimate() applies the deadline; these modes never call it or,
+    // for --lean, cannot skip the frames it drops
+    if (realtime_deadline_ms > 0 && (lean || !extra_streams.empty() || !gen_transforms_path.empty() ||
+                                     !apply_transforms_path.empty())) {
+        cerr << "--realtime cannot be combined with --lean, --stream, --gen-transforms or --apply-transforms" << endl;
+        return -1;
+    }
+
     VideoCapture cap;
     if (isdigit(source[0])) {
         cap.open(stoi(source));  // Open camera
@@ -233,39 +1310,263 @@ int main(int argc, char** argv) {
         return -1;
     }
 
-    Stabilizer stabilizer(25, "black", 0, false, false, 1e-3, 1e-1);
+    auto configure = [&](Stabilizer& s) {
+        if (track_keypoints) s.enable_keypoint_tracking();
+        if (tile_cols > 0 && tile_rows > 0) s.enable_tiled_detection(tile_cols, tile_rows);
+        s.set_detector(detector);
+        s.set_preprocessing(preprocess);
+        s.set_lookahead(lookahead);
+        if (budget_ms > 0) s.enable_adaptive_budget(budget_ms, 100, 1500, adaptive_pyramid);
+        s.set_processing_max_dim(processing_max_dim);
+        s.set_fused_warp(fused);
+        s.set_smoother(smoother);
+        s.set_motion_estimator(estimator);
+    };
 
-    namedWindow("Stabilized Video", WINDOW_NORMAL);
-    Mat frame, stabilized_frame, combinedFrame;
+    Stabilizer stabilizer(smoothing_radius, "black", 0, false, false, 1e-3, 1e-1);
+    configure(stabilizer);
+    if (!metrics_path.empty()) {
+        try {
+            stabilizer.enable_metrics(metrics_path);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return -1;
+        }
+    }
+    if (realtime_deadline_ms > 0) {
+        stabilizer.enable_realtime(realtime_deadline_ms);
+    }
+
+    // Two-pass offline mode: estimate and store all transforms, then warp in parallel
+    if (!gen_transforms_path.empty() || !apply_transforms_path.empty()) {
+        if (!apply_transforms_path.empty() && output_path.empty()) {
+            cerr << "--apply-transforms requires --output" << endl;
+            return -1;
+        }
+
+        try {
+            vector<TransformRecord> records;
+            Size frame_size;
+            if (!gen_transforms_path.empty()) {
+                if (segments > 1) {
+                    records = generate_transforms_segmented(source, segments, configure, smoothing_radius, frame_size);
+                } else {
+                    records = generate_transforms(cap, stabilizer, smoothing_radius, frame_size);
+                }
+                write_transform_file(gen_transforms_path, records, frame_size);
+                cout << "Wrote " << records.size() << " transforms to " << gen_transforms_path << endl;
+            }
+
+            if (!apply_transforms_path.empty()) {
+                records = read_transform_file(apply_transforms_path, &frame_size);
+
+                // Pass two reads the input again from the first frame
+                cap.release();
+                cap.open(source);
+                if (!cap.isOpened()) {
+                    cerr << "Error opening video source" << endl;
+                    return -1;
+                }
+
+                // The records only fit the input they were estimated on
+                Size input_size(static_cast<int>(cap.get(CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(CAP_PROP_FRAME_HEIGHT)));
+                if (input_size != frame_size) {
+                    cerr << "Error: " << apply_transforms_path << " is for " << frame_size.width << "x" << frame_size.height
+                         << " frames, but " << source << " is " << input_size.width << "x" << input_size.height << endl;
+                    return -1;
+                }
+                long input_frames = static_cast<long>(cap.get(CAP_PROP_FRAME_COUNT));
+                if (input_frames > 0 && static_cast<size_t>(input_frames) != records.size()) {
+                    cerr << "Warning: " << apply_transforms_path << " has " << records.size() << " transforms, but "
+                         << source << " reports " << input_frames << " frames" << endl;
+                }
+
+                double fps = cap.get(CAP_PROP_FPS);
+                VideoWriter writer(output_path, fourcc, fps > 0 ? fps : 30, frame_size);
+                if (!writer.isOpened()) {
+                    cerr << "Error opening output " << output_path << endl;
+                    return -1;
+                }
+
+                size_t frames_written = apply_transforms(cap, stabilizer, records, writer, threads);
+                cout << "Wrote " << frames_written << " stabilized frames to " << output_path << endl;
+            }
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return -1;
+        }
+
+        cap.release();
+        return 0;
+    }
+
+    // Multi-stream mode: every source gets its own Stabilizer, all share one worker pool
+    if (!extra_streams.empty()) {
+        cap.release();
+        vector<string> sources(1, source);
+        sources.insert(sources.end(), extra_streams.begin(), extra_streams.end());
+
+        vector<unique_ptr<VideoWriter> > writers(sources.size());
+        MultiStreamRunner runner(threads);
+        for (size_t i = 0; i < sources.size(); i++) {
+            if (output_path.empty()) {
+                runner.add_stream(sources[i], smoothing_radius, configure, [](const Mat&, const Mat&) { return true; });
+                continue;
+            }
+            // OUT.mp4 -> OUT_0.mp4, OUT_1.mp4, ...; .avi when OUT has no extension
+            size_t dot = output_path.find_last_of('.');
+            size_t slash = output_path.find_last_of("/\\");
+            if (slash != string::npos && dot != string::npos && dot < slash) dot = string::npos;
+            string stem = dot == string::npos ? output_path : output_path.substr(0, dot);
+            string extension = dot == string::npos ? ".avi" : output_path.substr(dot);
+            string stream_output = stem + "_" + to_string(i) + extension;
+            VideoWriter* writer = new VideoWriter();
+            writers[i].reset(writer);
+            runner.add_stream(sources[i], smoothing_radius, configure,
+                              [&runner, i, writer, stream_output, fourcc](const Mat&, const Mat& stabilized) {
+                if (!writer->isOpened()) {
+                    double fps = runner.source_fps(i);
+                    // Thrown into the stream's stats, stopping only this stream
+                    if (!writer->open(stream_output, fourcc, fps > 0 ? fps : 30, stabilized.size())) {
+                        throw runtime_error("Error opening output " + stream_output);
+                    }
+                }
+                writer->write(stabilized);
+                return true;
+            });
+        }
+
+        runner.run();
+        vector<MultiStreamRunner::StreamStats> stats = runner.stats();
+        for (size_t i = 0; i < stats.size(); i++) {
+            cout << "Stream " << i << " (" << stats[i].source << "): " << stats[i].frames_written << "/" << stats[i].frames_read
+                 << " frames, " << stats[i].fps() << " fps, " << stats[i].busy_seconds << " s worker time";
+            if (!stats[i].error.empty()) cout << ", error: " << stats[i].error;
+            cout << endl;
+        }
+        return 0;
+    }
 
     auto start_time = chrono::high_resolution_clock::now();
-    int frame_count = 0;
+    size_t frame_count = 0;
 
-    while (cap.read(frame)) {
-        auto frame_time = chrono::high_resolution_clock::now();
-        stabilized_frame = stabilizer.stabilize(frame);
+    // Batch mode for machines without a display: no window, every frame goes to the encoder
+    if (headless) {
+        if (output_path.empty()) {
+            cerr << "--headless requires --output" << endl;
+            return -1;
+        }
+        if (lean && isdigit(source[0])) {
+            cerr << "--lean needs a video file to re-decode frames from" << endl;
+            return -1;
+        }
+
+        double fps = cap.get(CAP_PROP_FPS);
+        Size frame_size(static_cast<int>(cap.get(CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(CAP_PROP_FRAME_HEIGHT)));
+        VideoWriter writer(output_path, fourcc, fps > 0 ? fps : 30, frame_size);
+        if (!writer.isOpened()) {
+            cerr << "Error opening output " << output_path << endl;
+            return -1;
+        }
+
+        try {
+            if (lean) {
+                frame_count = stabilize_to_writer_lean(cap, source, stabilizer, writer);
+            } else if (pipeline_mode) {
+                StabilizerPipeline pipeline(stabilizer);
+                frame_count = pipeline.run(cap, [&writer](const Mat&, const Mat& stabilized) {
+                    writer.write(stabilized);
+                    return true;
+                });
+            } else {
+                frame_count = stabilize_to_writer(cap, stabilizer, writer);
+            }
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return -1;
+        }
+        cap.release();
+        cout << "Wrote " << frame_count << " stabilized frames to " << output_path << endl;
+    } else {
+        namedWindow("Stabilized Video", WINDOW_NORMAL);
+        Mat frame, stabilized_frame, combinedFrame;
+
+        if (pipeline_mode) {
+            StabilizerPipeline pipeline(stabilizer);
+            auto last_output = chrono::high_resolution_clock::now();
+            frame_count = pipeline.run(cap, [&](const Mat& original, const Mat& stabilized) {
+                hconcat(original, stabilized, combinedFrame);
+
+                // Measure output rate of the whole pipeline
+                auto now = chrono::high_resolution_clock::now();
+                chrono::duration<double> elapsed = now - last_output;
+                last_output = now;
+                double fps = 1.0 / elapsed.count();
 
-        if (!stabilized_frame.empty()) {
-            hconcat(frame, stabilized_frame, combinedFrame);
+                putText(combinedFrame, "FPS: " + to_string(static_cast<int>(fps)), Point(10, 30), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 255, 0), 2);
+                imshow("Original and Stabilized Frames", combinedFrame);
 
-            // Measure FPS
-            auto end_time = chrono::high_resolution_clock::now();
-            chrono::duration<double> elapsed = end_time - frame_time;
-            double fps = 1.0 / elapsed.count();
+                // Exit on any key press
+                return waitKey(1) < 0;
+            });
+        } else {
+            while (cap.read(frame)) {
+                auto frame_time = chrono::high_resolution_clock::now();
+                stabilized_frame = stabilizer.stabilize(frame);
+
+                if (!stabilized_frame.empty()) {
+                    frame_count++;
+                    hconcat(frame, stabilized_frame, combinedFrame);
+
+                    // Measure FPS
+                    auto end_time = chrono::high_resolution_clock::now();
+                    chrono::duration<double> elapsed = end_time - frame_time;
+                    double fps = 1.0 / elapsed.count();
 
-            // Display FPS on the frame
-            putText(combinedFrame, "FPS: " + to_string(static_cast<int>(fps)), Point(10, 30), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 255, 0), 2);
+                    // Display FPS on the frame
+                    putText(combinedFrame, "FPS: " + to_string(static_cast<int>(fps)), Point(10, 30), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 255, 0), 2);
 
-            // Display the combined frame
-            imshow("Original and Stabilized Frames", combinedFrame);
+                    // Display the combined frame
+                    imshow("Original and Stabilized Frames", combinedFrame);
 
-            // Exit on any key press
-            if (waitKey(1) >= 0) break; 
+                    // Exit on any key press
+                    if (waitKey(1) >= 0) break; 
 
+                }
+            }
         }
+
+        cap.release();
+        destroyAllWindows();
     }
 
-    cap.release();
-    destroyAllWindows();
+    chrono::duration<double> total = chrono::high_resolution_clock::now() - start_time;
+    cout << "Throughput: " << frame_count << " frames in " << total.count() << " s ("
+         << (total.count() > 0 ? frame_count / total.count() : 0.0) << " fps)" << endl;
+    cout << "Keypoint detection frequency: " << stabilizer.detection_frequency() << endl;
+    cout << "Output latency: " << stabilizer.output_delay_frames() << " frames, p50/p95/p99 "
+         << stabilizer.output_latency_ms(0.5) << " / " << stabilizer.output_latency_ms(0.95) << " / "
+         << stabilizer.output_latency_ms(0.99) << " ms" << endl;
+    if (budget_ms > 0) {
+        cout << "Final corner budget: " << stabilizer.corner_budget() << endl;
+    }
+    if (DeadlineController* deadline = stabilizer.deadline_controller()) {
+        cout << "Degradation levels over " << deadline->frames() << " frames at " << deadline->deadline()
+             << " ms deadline:";
+        for (int level = 0; level < DEGRADATION_LEVEL_COUNT; level++) {
+            cout << " " << degradation_level_name(level) << " "
+                 << 100.0 * deadline->usage(static_cast<DegradationLevel>(level)) << "%";
+        }
+        cout << endl;
+    }
+    cout << "Frame buffer allocations: " << stabilizer.buffer_allocations() << endl;
+    if (MetricsRecorder* metrics = stabilizer.metrics_recorder()) {
+        for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+            MetricStage s = static_cast<MetricStage>(stage);
+            cout << metric_stage_name(stage) << " ms p50/p95/p99: " << metrics->percentile(s, 0.5) << " / "
+                 << metrics->percentile(s, 0.95) << " / " << metrics->percentile(s, 0.99) << endl;
+        }
+        cout << "Keypoint survival: " << metrics->keypoint_survival() << endl;
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef PROCESSING_RESIZE_H
+#define PROCESSING_RESIZE_H
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+// Motion estimation on a reduced copy of the frame, the C++ counterpart of
+// processing_max_dim in the Python VidStab. The frame that gets warped keeps
+// its original size.
+
+// Factor that brings the longest side of `size` down to `max_dim`. 1.0 when
+// no limit is set (max_dim <= 0) or the frame is already small enough.
+inline double processing_scale(cv::Size size, int max_dim) {
+    int longest = std::max(size.width, size.height);
+    if (max_dim <= 0 || longest <= max_dim) return 1.0;
+    return static_cast<double>(max_dim) / longest;
+}
+
+// Size of the estimation image for a given scale, as cv::resize rounds it.
+inline cv::Size processing_size(cv::Size size, double scale) {
+    if (scale == 1.0) return size;
+    return cv::Size(cvRound(size.width * scale), cvRound(size.height * scale));
+}
+
+// Downscales the estimation image into `resized`, which already has the
+// processing_size() of the input.
+inline void resize_for_processing(const cv::Mat& gray, cv::Mat& resized) {
+    cv::resize(gray, resized, resized.size(), 0, 0, cv::INTER_AREA);
+}
+
+#endif // PROCESSING_RESIZE_H
@@ -0,0 +1,194 @@
+#ifndef PROSAC_ESTIMATOR_H
+#define PROSAC_ESTIMATOR_H
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+enum MotionEstimator {
+    ESTIMATOR_RANSAC,  // the OpenCV call each stabilizer always used
+    ESTIMATOR_PROSAC   // estimate_similarity_prosac
+};
+
+// Parses "ransac" or "prosac".
+inline bool parse_motion_estimator(const std::string& name, MotionEstimator& estimator) {
+    if (name == "ransac") estimator = ESTIMATOR_RANSAC;
+    else if (name == "prosac") estimator = ESTIMATOR_PROSAC;
+    else return false;
+    return true;
+}
+
+// Similarity x' = a x - b y + tx, y' = b x + a y + ty.
+struct Similarity {
+    double a, b, tx, ty;
+
+    Similarity() : a(1), b(0), tx(0), ty(0) {}
+
+    double squared_error(const cv::Point2f& from, const cv::Point2f& to) const {
+        double ex = a * from.x - b * from.y + tx - to.x;
+        double ey = b * from.x + a * from.y + ty - to.y;
+        return ex * ex + ey * ey;
+    }
+
+    cv::Mat matrix() const {
+        return (cv::Mat_<double>(2, 3) << a, -b, tx, b, a, ty);
+    }
+
+    // Writes the top two rows of the matrix into an existing 2x3 or 3x3
+    // CV_64F buffer, leaving a third row alone.
+    void write(cv::Mat& m) const {
+        double* row0 = m.ptr<double>(0);
+        double* row1 = m.ptr<double>(1);
+        row0[0] = a; row0[1] = -b; row0[2] = tx;
+        row1[0] = b; row1[1] = a;  row1[2] = ty;
+    }
+};
+
+// Closed-form least-squares similarity over the matches selected by `use`
+// (all of them when empty). Returns false when the points are degenerate.
+inline bool fit_similarity(const std::vector<cv::Point2f>& from, const std::vector<cv::Point2f>& to,
+                           const std::vector<int>& use, Similarity& model) {
+    size_t count = use.empty() ? from.size() : use.size();
+    if (count < 2) return false;
+
+    double fx = 0, fy = 0, tx = 0, ty = 0;
+    for (size_t k = 0; k < count; k++) {
+        int i = use.empty() ? static_cast<int>(k) : use[k];
+        fx += from[i].x; fy += from[i].y;
+        tx += to[i].x; ty += to[i].y;
+    }
+    fx /= count; fy /= count; tx /= count; ty /= count;
+
+    double norm = 0, dot = 0, cross = 0;
+    for (size_t k = 0; k < count; k++) {
+        int i = use.empty() ? static_cast<int>(k) : use[k];
+        double x = from[i].x - fx, y = from[i].y - fy;
+        double u = to[i].x - tx, v = to[i].y - ty;
+        norm += x * x + y * y;
+        dot += x * u + y * v;
+        cross += x * v - y * u;
+    }
+    if (norm < 1e-9) return false;
+
+    model.a = dot / norm;
+    model.b = cross / norm;
+    model.tx = tx - (model.a * fx - model.b * fy);
+    model.ty = ty - (model.b * fx + model.a * fy);
+    return true;
+}
+
+// Robust similarity between matched points, PROSAC-style (Chum & Matas,
+// 2005), for the frame-to-frame motion of the stabilizers.
+//
+// Matches are ranked by `quality` (lower is better; the LK `err` output), and
+// minimal two-point samples are drawn from a pool of the best matches that
+// grows on the PROSAC schedule, so good hypotheses usually turn up within a
+// handful of iterations. The iteration limit shrinks as better models are
+// found, to what is needed for `confidence` of having drawn one all-inlier
+// sample. The best model is then refit by least squares on its inliers,
+// twice, re-selecting inliers in between.
+//
+// Returns false, leaving `result` alone, with fewer than two usable matches.
+// `inlier_mask` gets one byte per match.
+inline bool estimate_similarity_prosac(const std::vector<cv::Point2f>& from, const std::vector<cv::Point2f>& to,
+                                       const std::vector<float>& quality, std::vector<uchar>& inlier_mask,
+                                       Similarity& result, double threshold = 3.0, double confidence = 0.995,
+                                       int max_iterations = 2000) {
+    const int m = 2;
+    int total = static_cast<int>(from.size());
+    inlier_mask.assign(total, 0);
+    if (total < m) return false;
+
+    std::vector<int> order(total);
+    for (int i = 0; i < total; i++) order[i] = i;
+    if (quality.size() == from.size()) {
+        std::stable_sort(order.begin(), order.end(), [&quality](int a, int b) { return quality[a] < quality[b]; });
+    }
+
+    double threshold2 = threshold * threshold;
+    cv::RNG rng(0x5eed);
+    Similarity best;
+    int best_inliers = -1;
+    int limit = max_iterations;
+
+    // PROSAC growth: T_n is the expected number of samples drawn from the top
+    // n among max_iterations uniform samples; t_n its rounded running total.
+    int n = m;
+    double T_n = max_iterations;
+    for (int i = 0; i < m; i++) T_n *= static_cast<double>(n - i) / (total - i);
+    double t_n = 1;
+
+    std::vector<int> sample(m), inliers;
+    for (int t = 1; t <= limit; t++) {
+        if (t > t_n && n < total) {
+            double T_next = T_n * (n + 1) / (n + 1 - m);
+            t_n += std::ceil(T_next - T_n);
+            T_n = T_next;
+            n++;
+        }
+
+        // The newest match in the pool plus one from the rest of it, or, once
+        // the schedule has run out, any two of the pool
+        if (t_n >= t) {
+            sample[0] = order[n - 1];
+            sample[1] = order[rng.uniform(0, n - 1)];
+        } else {
+            sample[0] = order[rng.uniform(0, n)];
+            do {
+                sample[1] = order[rng.uniform(0, n)];
+            } while (sample[1] == sample[0]);
+        }
+
+        Similarity model;
+        if (!fit_similarity(from, to, sample, model)) continue;
+
+        int count = 0;
+        for (int i = 0; i < total; i++) {
+            if (model.squared_error(from[i], to[i]) <= threshold2) count++;
+        }
+        if (count > best_inliers) {
+            best_inliers = count;
+            best = model;
+
+            double all_inliers = std::pow(static_cast<double>(count) / total, m);
+            if (all_inliers >= 1.0) break;
+            if (all_inliers > 0) {
+                double needed = std::log(1.0 - confidence) / std::log(1.0 - all_inliers);
+                limit = std::min(limit, static_cast<int>(std::ceil(needed)));
+            }
+        }
+    }
+    if (best_inliers < m) return false;
+
+    for (int round = 0; round < 2; round++) {
+        inliers.clear();
+        for (int i = 0; i < total; i++) {
+            if (best.squared_error(from[i], to[i]) <= threshold2) inliers.push_back(i);
+        }
+        Similarity refined;
+        if (inliers.size() < static_cast<size_t>(m) || !fit_similarity(from, to, inliers, refined)) break;
+        best = refined;
+    }
+
+    for (int i = 0; i < total; i++) {
+        inlier_mask[i] = best.squared_error(from[i], to[i]) <= threshold2 ? 1 : 0;
+    }
+    result = best;
+    return true;
+}
+
+// As above, as a 2x3 CV_64F matrix, or an empty one when no model was found.
+inline cv::Mat estimate_similarity_prosac(const std::vector<cv::Point2f>& from, const std::vector<cv::Point2f>& to,
+                                          const std::vector<float>& quality, std::vector<uchar>& inlier_mask,
+                                          double threshold = 3.0, double confidence = 0.995,
+                                          int max_iterations = 2000) {
+    Similarity model;
+    if (!estimate_similarity_prosac(from, to, quality, inlier_mask, model, threshold, confidence, max_iterations)) {
+        return cv::Mat();
+    }
+    return model.matrix();
+}
+
+#endif // PROSAC_ESTIMATOR_H
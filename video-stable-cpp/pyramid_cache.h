@@ -0,0 +1,69 @@
+#ifndef PYRAMID_CACHE_H
+#define PYRAMID_CACHE_H
+
+#include <opencv2/video.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Keeps the optical-flow pyramid of the previous frame around so that
+// calcOpticalFlowPyrLK does not rebuild it. Every frame's pyramid is built
+// exactly once with buildOpticalFlowPyramid and is reused as the "previous"
+// pyramid on the next call. Swapping the two pyramids also lets the build
+// reuse the old buffers instead of allocating new ones.
+class PyramidCache {
+public:
+    PyramidCache(cv::Size win_size = cv::Size(31, 31), int max_level = 3)
+        : win_size(win_size), max_level(max_level), previous_levels(0), current_levels(0) {}
+
+    // Starts a new sequence at `gray`.
+    void reset(const cv::Mat& gray) {
+        previous_levels = cv::buildOpticalFlowPyramid(gray, previous_pyramid, win_size, max_level);
+    }
+
+    // Tracks `previous_points` from the cached pyramid into `gray`, then makes
+    // `gray` the previous frame for the next call.
+    void track(const cv::Mat& gray, const std::vector<cv::Point2f>& previous_points,
+               std::vector<cv::Point2f>& current_points, std::vector<unsigned char>& status, std::vector<float>& err,
+               cv::TermCriteria criteria, int flags = 0, double min_eig_threshold = 1e-4) {
+        current_levels = cv::buildOpticalFlowPyramid(gray, current_pyramid, win_size, max_level);
+
+        if (previous_points.empty()) {
+            current_points.clear();
+            status.clear();
+            err.clear();
+        } else {
+            int levels = std::min(previous_levels, current_levels);
+            cv::calcOpticalFlowPyrLK(previous_pyramid, current_pyramid, previous_points, current_points, status, err,
+                                     win_size, levels, criteria, flags, min_eig_threshold);
+        }
+
+        std::swap(previous_pyramid, current_pyramid);
+        std::swap(previous_levels, current_levels);
+    }
+
+    // Pyramid depth from the next frame on. Until the cached pyramid has been
+    // rebuilt, tracking uses the levels both pyramids have.
+    void set_max_level(int max_level) {
+        this->max_level = max_level;
+    }
+
+    int get_max_level() const { return max_level; }
+
+    // Level 0 of the cached pyramid, i.e. the last frame passed in. The buffer
+    // is recycled by the next track() call.
+    cv::Mat previous_image() const {
+        return previous_pyramid.empty() ? cv::Mat() : previous_pyramid[0];
+    }
+
+private:
+    cv::Size win_size;
+    int max_level;
+
+    std::vector<cv::Mat> previous_pyramid;
+    std::vector<cv::Mat> current_pyramid;
+    int previous_levels;
+    int current_levels;
+};
+
+#endif // PYRAMID_CACHE_H
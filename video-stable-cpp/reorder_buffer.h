@@ -0,0 +1,58 @@
+#ifndef REORDER_BUFFER_H
+#define REORDER_BUFFER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <utility>
+
+// Collects items finished out of order by parallel workers and releases them
+// strictly by index, starting at 0. push() blocks while the index is
+// `capacity` or more ahead of the next one to be released, which bounds
+// memory; capacity has to be at least the number of producers.
+template <typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t capacity) : capacity(capacity > 0 ? capacity : 1), next_index(0), closed(false) {}
+
+    bool push(size_t index, T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this, index] { return closed || index < next_index + capacity; });
+        if (closed) return false;
+        items.insert(std::make_pair(index, std::move(item)));
+        if (index == next_index) ready.notify_all();
+        return true;
+    }
+
+    // Blocks until the next item in sequence arrives. Returns false once the
+    // buffer is closed and that item is not available.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return closed || (!items.empty() && items.begin()->first == next_index); });
+        if (items.empty() || items.begin()->first != next_index) return false;
+        item = std::move(items.begin()->second);
+        items.erase(items.begin());
+        next_index++;
+        not_full.notify_all();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        ready.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    size_t capacity;
+    size_t next_index;
+    bool closed;
+    std::map<size_t, T> items;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable not_full;
+};
+
+#endif // REORDER_BUFFER_H
@@ -0,0 +1,61 @@
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// FIFO over a circular vector. Unlike std::deque, which allocates and frees
+// a node every few elements as items stream through, it only allocates when
+// it grows past its largest size so far, so a queue that holds a bounded
+// number of frames stops allocating once warmed up. Popped slots are reset
+// to T() so that Mats release their buffers right away.
+template <typename T>
+class RingQueue {
+public:
+    RingQueue() : head(0), count(0) {}
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    T& front() { return items[head]; }
+    const T& front() const { return items[head]; }
+
+    // i-th item from the front.
+    T& operator[](size_t i) { return items[(head + i) % items.size()]; }
+    const T& operator[](size_t i) const { return items[(head + i) % items.size()]; }
+
+    void push_back(const T& item) {
+        if (count == items.size()) grow();
+        items[(head + count) % items.size()] = item;
+        count++;
+    }
+
+    void pop_front() {
+        items[head] = T();
+        head = (head + 1) % items.size();
+        count--;
+    }
+
+    // Empties the queue, keeping its capacity.
+    void clear() {
+        while (count > 0) pop_front();
+        head = 0;
+    }
+
+private:
+    void grow() {
+        std::vector<T> larger(std::max<size_t>(2 * items.size(), 8));
+        for (size_t i = 0; i < count; i++) {
+            larger[i] = items[(head + i) % items.size()];
+        }
+        items.swap(larger);
+        head = 0;
+    }
+
+    std::vector<T> items;
+    size_t head;
+    size_t count;
+};
+
+#endif // RING_QUEUE_H
@@ -4,16 +4,28 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <iostream>
-#include <deque>
 #include <vector>
 
+#include "keypoint_tracker.h"
+#include "keypoint_budget.h"
+#include "prosac_estimator.h"
+#include "pyramid_cache.h"
+#include "processing_resize.h"
+#include "fused_warp.h"
+#include "frame_pool.h"
+#include "ring_queue.h"
+#include "trajectory_smoother.h"
+#include "frame_preprocessor.h"
+
 using namespace cv;
 using namespace std;
 
 class Stabilizer {
 public:
     Stabilizer(int smoothing_radius = 25, string border_type = "black", int border_size = 0, bool crop_n_zoom = false, bool logging = false)
-        : smoothing_radius(smoothing_radius), border_size(border_size), crop_n_zoom(crop_n_zoom), logging(logging) {
+        : smoothing_radius(smoothing_radius), border_size(border_size), crop_n_zoom(crop_n_zoom), logging(logging),
+          keypoint_tracker(200, 0.05, 30.0), motion_estimator(ESTIMATOR_RANSAC),
+          processing_max_dim(0), estimation_scale(1.0), use_fused_warp(false) {
         
         if (border_type == "black") border_mode = BORDER_CONSTANT;
         else if (border_type == "reflect") border_mode = BORDER_REFLECT;
@@ -22,8 +34,87 @@ public:
         else if (border_type == "wrap") border_mode = BORDER_WRAP;
         else border_mode = BORDER_CONSTANT;
 
-        clahe = createCLAHE(2.0, Size(8, 8));
-        box_filter = Mat::ones(1, smoothing_radius, CV_32F) / smoothing_radius;
+        set_smoother(SMOOTHER_MOVING_AVERAGE);
+    }
+
+    // Carry tracked keypoints forward instead of re-detecting every frame;
+    // corners are detected again once fewer than redetect_ratio of them survive.
+    void enable_keypoint_tracking(double redetect_ratio = 0.5, bool redetect_lost_regions = true) {
+        keypoint_tracker.enable_tracking(redetect_ratio, redetect_lost_regions);
+    }
+
+    // Spread corner detection over a cols x rows grid of tiles, detected in
+    // parallel with an equal share of corners each, for even coverage.
+    void enable_tiled_detection(int cols = 4, int rows = 4) {
+        keypoint_tracker.enable_tiling(cols, rows);
+    }
+
+    // Contrast preprocessing of the estimation image: CLAHE (the default),
+    // a cheap global normalization, or none for well-lit footage.
+    void set_preprocessing(PreprocessMode mode) {
+        preprocessor.set_mode(mode);
+    }
+
+    // Track FAST or ORB corners instead of goodFeaturesToTrack.
+    void set_detector(DetectorType type) {
+        keypoint_tracker.set_detector(type);
+    }
+
+    // Let the corner budget follow tracking quality and time: keep estimation
+    // under target_ms per frame with between min_corners and max_corners
+    // corners, and with adapt_pyramid also move the LK pyramid depth.
+    // See KeypointBudgetController.
+    void enable_adaptive_budget(double target_ms, int min_corners, int max_corners, bool adapt_pyramid = false) {
+        keypoint_budget = makePtr<KeypointBudgetController>(keypoint_tracker.get_max_corners(), min_corners,
+                                                            max_corners, target_ms);
+        if (adapt_pyramid) {
+            keypoint_budget->enable_pyramid_control(pyramid_cache.get_max_level());
+        }
+    }
+
+    // Current corner budget.
+    int corner_budget() const {
+        return keypoint_tracker.get_max_corners();
+    }
+
+    // Robust estimator for the frame-to-frame motion: OpenCV's RANSAC (the
+    // default) or a PROSAC-style similarity fit that samples the matches with
+    // the lowest LK error first and stops early (estimate_similarity_prosac).
+    void set_motion_estimator(MotionEstimator estimator) {
+        motion_estimator = estimator;
+    }
+
+    // Fraction of frames that ran keypoint detection.
+    double detection_frequency() const {
+        return keypoint_tracker.detection_frequency();
+    }
+
+    // Estimate motion on a copy of the frame whose longest side is at most
+    // max_dim pixels. Output frames keep the input resolution. Call before
+    // the first frame.
+    void set_processing_max_dim(int max_dim) {
+        processing_max_dim = max_dim;
+    }
+
+    // Produce output frames with a single warp straight to the final size
+    // instead of border, warp, ROI copy and crop_n_zoom resize.
+    void set_fused_warp(bool enabled) {
+        use_fused_warp = enabled;
+    }
+
+    // Smoother applied to the estimated motion; a moving average over
+    // smoothing_radius frames by default. Call before the first frame.
+    void set_smoother(SmootherType type) {
+        smoother = create_trajectory_smoother(type, smoothing_radius);
+    }
+
+    // Pooled buffers (queued frames, estimation images, warp buffers and
+    // output frames) allocated so far; constant once warmed up. The estimate
+    // and output transforms reuse member buffers. Allocations inside OpenCV
+    // calls such as calcOpticalFlowPyrLK and estimateAffinePartial2D are not
+    // counted.
+    size_t buffer_allocations() const {
+        return frame_pool.allocations();
     }
 
     Mat stabilize(const Mat& frame) {
@@ -33,13 +124,11 @@ public:
             initialize(frame);
             return frame;
         } else if (frame_queue.size() < smoothing_radius) {
-            frame_queue.push_back(frame);
-            frame_queue_indexes.push_back(frame_queue_indexes.back() + 1);
+            frame_queue.push_back(frame_pool.copy(frame));
             generate_transformations(frame);
             return frame;
         } else {
-            frame_queue.push_back(frame);
-            frame_queue_indexes.push_back(frame_queue_indexes.back() + 1);
+            frame_queue.push_back(frame_pool.copy(frame));
             generate_transformations(frame);
             apply_transformations();
             return stabilized_frame;
@@ -48,94 +137,126 @@ public:
 
 private:
     void initialize(const Mat& frame) {
-        Mat gray;
-        cvtColor(frame, gray, COLOR_BGR2GRAY);
-        clahe->apply(gray, gray);
-        goodFeaturesToTrack(gray, previous_keypoints, 200, 0.05, 30.0, Mat(), 3, false, 0.04);
+        estimation_scale = processing_scale(frame.size(), processing_max_dim);
+        Mat gray = estimation_gray(frame);
+        keypoint_tracker.detect(gray, previous_keypoints);
         frame_height = frame.rows;
         frame_width = frame.cols;
-        frame_queue.push_back(frame);
-        frame_queue_indexes.push_back(0);
-        previous_gray = gray.clone();
+        frame_queue.push_back(frame_pool.copy(frame));
+        pyramid_cache.reset(gray);
+
+        smoother->reset();
+        smoothed_transform = Vec3d(0, 0, 0);
     }
 
     void generate_transformations(const Mat& frame) {
-        Mat gray;
-        cvtColor(frame, gray, COLOR_BGR2GRAY);
-        clahe->apply(gray, gray);
+        int64 start = getTickCount();
+        Mat gray = estimation_gray(frame);
 
-        vector<Point2f> curr_kps;
-        vector<uchar> status;
-        vector<float> err;
         TermCriteria termcrit(TermCriteria::COUNT | TermCriteria::EPS, 20, 0.03);
-        calcOpticalFlowPyrLK(previous_gray, gray, previous_keypoints, curr_kps, status, err, Size(31, 31), 3, termcrit, 0, 0.001);
+        pyramid_cache.track(gray, previous_keypoints, curr_kps, status, err, termcrit, 0, 0.001);
 
-        vector<Point2f> valid_curr_kps, valid_previous_keypoints;
+        valid_curr_kps.clear();
+        valid_previous_keypoints.clear();
+        valid_err.clear();
         for (size_t i = 0; i < status.size(); i++) {
             if (status[i]) {
                 valid_curr_kps.push_back(curr_kps[i]);
                 valid_previous_keypoints.push_back(previous_keypoints[i]);
+                valid_err.push_back(err[i]);
             }
         }
 
-        Mat transformation;
+        // Identity unless an estimator finds the motion; reuses its buffer
+        // except where estimateAffinePartial2D returns a new one
+        transformation.create(2, 3, CV_64F);
+        setIdentity(transformation);
+        int inliers = 0;
+        double reprojection_error = 0;
         if (valid_curr_kps.size() >= 4 && valid_previous_keypoints.size() >= 4) {
-            transformation = estimateAffinePartial2D(valid_previous_keypoints, valid_curr_kps);
-        } else {
-            transformation = Mat::eye(2, 3, CV_64F);
-        }
-
-        if (transforms.empty()) {
-            transforms = Mat::zeros(1, smoothing_radius, CV_64FC3);
+            if (motion_estimator == ESTIMATOR_PROSAC) {
+                Similarity similarity;
+                if (estimate_similarity_prosac(valid_previous_keypoints, valid_curr_kps, valid_err, inlier_mask,
+                                               similarity)) {
+                    similarity.write(transformation);
+                }
+            } else {
+                Mat affine = estimateAffinePartial2D(valid_previous_keypoints, valid_curr_kps, inlier_mask);
+                if (!affine.empty()) transformation = affine;
+            }
+            inliers = countNonZero(inlier_mask);
+            reprojection_error = mean_reprojection_error(transformation, valid_previous_keypoints, valid_curr_kps,
+                                                         inlier_mask);
         }
 
-        double dx = transformation.at<double>(0, 2);
-        double dy = transformation.at<double>(1, 2);
+        // Translation back to full-resolution pixels; rotation is scale-free
+        double dx = transformation.at<double>(0, 2) / estimation_scale;
+        double dy = transformation.at<double>(1, 2) / estimation_scale;
         double da = atan2(transformation.at<double>(1, 0), transformation.at<double>(0, 0));
 
-        transforms.at<Vec3d>(0, frame_queue_indexes.back() % smoothing_radius) = Vec3d(dx, dy, da);
+        smoothed_transform = smoother->update(Vec3d(dx, dy, da));
+
+        previous_keypoints.swap(valid_curr_kps);
+        keypoint_tracker.update(gray, previous_keypoints);
 
-        frame_transform = Mat(transforms).reshape(1);
-        path = cumsum(frame_transform);
-        smoothed_path = path.clone();
+        if (keypoint_budget) {
+            keypoint_budget->update(inliers, reprojection_error, (getTickCount() - start) * 1000.0 / getTickFrequency());
+            keypoint_tracker.set_max_corners(keypoint_budget->corners());
+            if (keypoint_budget->controls_pyramid()) {
+                pyramid_cache.set_max_level(keypoint_budget->pyramid_levels());
+            }
+        }
+    }
 
-        goodFeaturesToTrack(gray, previous_keypoints, 200, 0.05, 30.0, Mat(), 3, false, 0.04);
-        previous_gray = gray.clone();
+    // Gray, preprocessed and possibly downscaled copy of `frame` for motion
+    // estimation, in pooled buffers.
+    Mat estimation_gray(const Mat& frame) {
+        Mat gray = frame_pool.acquire(frame.size(), CV_8UC1);
+        cvtColor(frame, gray, COLOR_BGR2GRAY);
+        if (estimation_scale != 1.0) {
+            Mat resized = frame_pool.acquire(processing_size(frame.size(), estimation_scale), CV_8UC1);
+            resize_for_processing(gray, resized);
+            gray = resized;
+        }
+        preprocessor.apply(gray);
+        return gray;
     }
 
     void apply_transformations() {
         Mat frame = frame_queue.front();
         frame_queue.pop_front();
-        frame_queue_indexes.pop_front();
 
-        Mat bordered_frame;
-        copyMakeBorder(frame, bordered_frame, border_size, border_size, border_size, border_size, border_mode, Scalar(0, 0, 0));
+        double dx = smoothed_transform[0];
+        double dy = smoothed_transform[1];
+        double da = smoothed_transform[2];
 
-        Vec3d transform_smoothed = transforms.at<Vec3d>(0, frame_queue_indexes.front() % smoothing_radius);
-        double dx = transform_smoothed[0];
-        double dy = transform_smoothed[1];
-        double da = transform_smoothed[2];
+        transform.create(2, 3, CV_64F);
+        double* m = transform.ptr<double>();
+        m[0] = cos(da); m[1] = -sin(da); m[2] = dx;
+        m[3] = sin(da); m[4] = cos(da);  m[5] = dy;
 
-        Mat transform = (Mat_<double>(2, 3) << cos(da), -sin(da), dx, sin(da), cos(da), dy);
+        if (use_fused_warp) {
+            Mat output = frame_pool.acquire(frame.size(), frame.type());
+            fused_warp(frame, output, transform, border_size, crop_n_zoom, border_mode);
+            stabilized_frame = output;
+            return;
+        }
 
-        Mat frame_wrapped;
-        warpAffine(bordered_frame, frame_wrapped, transform, bordered_frame.size(), INTER_LINEAR, border_mode, Scalar(0, 0, 0));
+        Mat bordered_frame = frame_pool.acquire(Size(frame.cols + 2 * border_size, frame.rows + 2 * border_size), frame.type());
+        copyMakeBorder(frame, bordered_frame, border_size, border_size, border_size, border_size, border_mode, Scalar(0, 0, 0));
 
-        stabilized_frame = frame_wrapped(Rect(border_size, border_size, frame_width, frame_height)).clone();
+        Mat frame_wrapped = frame_pool.acquire(bordered_frame.size(), frame.type());
+        warpAffine(bordered_frame, frame_wrapped, transform, bordered_frame.size(), INTER_LINEAR, border_mode, Scalar(0, 0, 0));
 
+        Mat output = frame_pool.acquire(frame.size(), frame.type());
         if (crop_n_zoom) {
-            Rect roi(border_size, border_size, frame_width - 2 * border_size, frame_height - 2 * border_size);
-            Mat frame_cropped = stabilized_frame(roi);
-            resize(frame_cropped, stabilized_frame, Size(frame_width, frame_height), 0, 0, INTER_LINEAR);
-        }
-    }
-
-    Mat cumsum(const Mat& src) {
-        Mat dst = src.clone();
-        for (int i = 1; i < dst.rows; ++i) {
-            dst.row(i) += dst.row(i - 1);
+            // Inner crop of the frame area, which starts border_size into the warped buffer
+            Rect roi(2 * border_size, 2 * border_size, frame_width - 2 * border_size, frame_height - 2 * border_size);
+            resize(frame_wrapped(roi), output, Size(frame_width, frame_height), 0, 0, INTER_LINEAR);
+        } else {
+            frame_wrapped(Rect(border_size, border_size, frame_width, frame_height)).copyTo(output);
         }
-        return dst;
+        stabilized_frame = output;
     }
 
     int smoothing_radius;
@@ -143,17 +264,28 @@ private:
     bool crop_n_zoom;
     bool logging;
     int border_mode;
-    Ptr<CLAHE> clahe;
-    Mat box_filter;
-    deque<Mat> frame_queue;
-    deque<int> frame_queue_indexes;
-    Mat transforms;
-    Mat frame_transform;
-    Mat path;
-    Mat smoothed_path;
-    Mat frame_transforms_smoothed;
-    Mat previous_gray;
+    FramePreprocessor preprocessor;
+    RingQueue<Mat> frame_queue;
+    PyramidCache pyramid_cache;
     vector<Point2f> previous_keypoints;
+    // Per-frame scratch, kept to reuse capacity
+    vector<Point2f> curr_kps, valid_curr_kps, valid_previous_keypoints;
+    vector<uchar> status;
+    vector<float> err;
+    vector<float> valid_err;
+    vector<uchar> inlier_mask;
+    Mat transformation, transform;
+    FramePool frame_pool;
+    KeypointTracker keypoint_tracker;
+    MotionEstimator motion_estimator;
+    Ptr<KeypointBudgetController> keypoint_budget;
+    int processing_max_dim;
+    double estimation_scale;
+    bool use_fused_warp;
     int frame_height, frame_width;
     Mat stabilized_frame;
+
+    // Motion smoothing
+    Ptr<TrajectorySmoother> smoother;
+    Vec3d smoothed_transform;
 };
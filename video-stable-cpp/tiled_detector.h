@@ -0,0 +1,79 @@
+#ifndef TILED_DETECTOR_H
+#define TILED_DETECTOR_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// goodFeaturesToTrack over a grid of tiles, one tile per parallel_for_ task.
+//
+// Every tile gets an equal share of `max_corners` and applies `quality_level`
+// relative to its own strongest corner, so weakly textured areas still
+// contribute points instead of one busy region taking the whole budget. The
+// tiles are views into `gray`, so corner responses near tile edges see the
+// real neighbouring pixels. `min_distance` is enforced within each tile only;
+// two corners on either side of a tile edge may be closer than that.
+//
+// As with goodFeaturesToTrack, the result is at most `max_corners` points,
+// strongest first. Each tile's corners are scored with the minimum
+// eigenvalue goodFeaturesToTrack ranks them by, recomputed on a small patch
+// around each corner, and the merged set is sorted by it and cut to the
+// budget. Ties keep tile order, so the result stays deterministic.
+inline void detect_tiled_corners(const cv::Mat& gray, std::vector<cv::Point2f>& corners, int max_corners,
+                                 double quality_level, double min_distance, const cv::Mat& mask, cv::Size grid) {
+    int cols = std::max(grid.width, 1);
+    int rows = std::max(grid.height, 1);
+    int tiles = cols * rows;
+    int quota = (max_corners + tiles - 1) / tiles;
+
+    std::vector<std::vector<cv::Point2f> > tile_corners(tiles);
+    std::vector<std::vector<float> > tile_responses(tiles);
+    cv::parallel_for_(cv::Range(0, tiles), [&](const cv::Range& range) {
+        for (int t = range.start; t < range.end; t++) {
+            int x0 = gray.cols * (t % cols) / cols;
+            int x1 = gray.cols * (t % cols + 1) / cols;
+            int y0 = gray.rows * (t / cols) / rows;
+            int y1 = gray.rows * (t / cols + 1) / rows;
+            cv::Rect tile(x0, y0, x1 - x0, y1 - y0);
+            if (tile.width < 8 || tile.height < 8) continue;
+
+            cv::Mat tile_mask = mask.empty() ? cv::Mat() : mask(tile);
+            std::vector<cv::Point2f>& found = tile_corners[t];
+            cv::goodFeaturesToTrack(gray(tile), found, quota, quality_level, min_distance, tile_mask, 3, false, 0.04);
+            std::vector<float>& responses = tile_responses[t];
+            responses.resize(found.size());
+            cv::Mat eigen;
+            for (size_t i = 0; i < found.size(); i++) {
+                found[i].x += x0;
+                found[i].y += y0;
+
+                // goodFeaturesToTrack's blockSize 3 and Sobel aperture 3 reach
+                // two pixels out, so a 7x7 patch gives the same value
+                int x = cvRound(found[i].x), y = cvRound(found[i].y);
+                cv::Rect patch = cv::Rect(x - 3, y - 3, 7, 7) & cv::Rect(0, 0, gray.cols, gray.rows);
+                cv::cornerMinEigenVal(gray(patch), eigen, 3, 3);
+                responses[i] = eigen.at<float>(y - patch.y, x - patch.x);
+            }
+        }
+    });
+
+    std::vector<std::pair<float, cv::Point2f> > scored;
+    for (int t = 0; t < tiles; t++) {
+        for (size_t i = 0; i < tile_corners[t].size(); i++) {
+            scored.push_back(std::make_pair(tile_responses[t][i], tile_corners[t][i]));
+        }
+    }
+    std::stable_sort(scored.begin(), scored.end(),
+                     [](const std::pair<float, cv::Point2f>& a, const std::pair<float, cv::Point2f>& b) {
+                         return a.first > b.first;
+                     });
+
+    corners.clear();
+    for (size_t i = 0; i < scored.size() && static_cast<int>(corners.size()) < max_corners; i++) {
+        corners.push_back(scored[i].second);
+    }
+}
+
+#endif // TILED_DETECTOR_H
@@ -0,0 +1,196 @@
+#ifndef TRAJECTORY_SMOOTHER_H
+#define TRAJECTORY_SMOOTHER_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/video.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Streaming smoothers for the per-frame (dx, dy, da) motion the stabilizers
+// estimate. update() takes the newest value and returns the smoothed one in
+// constant time, whatever the window size.
+class TrajectorySmoother {
+public:
+    virtual ~TrajectorySmoother() {}
+
+    // Forgets all history, e.g. at the start of a new sequence.
+    virtual void reset() = 0;
+
+    virtual cv::Vec3d update(const cv::Vec3d& value) = 0;
+
+    // Advances one frame without a measurement, e.g. when a real-time
+    // stabilizer skips estimation, and returns the smoothed value.
+    virtual cv::Vec3d predict() = 0;
+};
+
+// Mean of the last `window` values (fewer during warm-up). The running sum is
+// rebuilt from the ring every `window` frames so rounding error cannot build
+// up, which keeps the cost amortized O(1).
+class MovingAverageSmoother : public TrajectorySmoother {
+public:
+    explicit MovingAverageSmoother(int window)
+        : values(std::max(window, 1)), next(0), count(0) {}
+
+    void reset() {
+        next = 0;
+        count = 0;
+        sum = cv::Vec3d(0, 0, 0);
+    }
+
+    cv::Vec3d update(const cv::Vec3d& value) {
+        if (count == values.size()) {
+            sum -= values[next];
+        } else {
+            count++;
+        }
+        values[next] = value;
+        sum += value;
+
+        next++;
+        if (next == values.size()) {
+            next = 0;
+            sum = cv::Vec3d(0, 0, 0);
+            for (size_t i = 0; i < count; i++) {
+                sum += values[i];
+            }
+        }
+        return sum * (1.0 / count);
+    }
+
+    // Repeats the current mean.
+    cv::Vec3d predict() {
+        return update(count > 0 ? sum * (1.0 / count) : cv::Vec3d(0, 0, 0));
+    }
+
+private:
+    std::vector<cv::Vec3d> values;
+    size_t next;
+    size_t count;
+    cv::Vec3d sum;
+};
+
+// Causal third-order recursive Gaussian (Young & van Vliet, 1995). Three
+// multiply-adds per component per frame for any sigma; the output lags the
+// input by roughly sigma frames, like any causal low-pass.
+class RecursiveGaussianSmoother : public TrajectorySmoother {
+public:
+    explicit RecursiveGaussianSmoother(double sigma) : primed(false) {
+        sigma = std::max(sigma, 0.5);
+        double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+        double q2 = q * q;
+        double q3 = q2 * q;
+        double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+        b1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+        b2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+        b3 = 0.422205 * q3 / b0;
+        gain = 1.0 - (b1 + b2 + b3);
+    }
+
+    void reset() {
+        primed = false;
+    }
+
+    cv::Vec3d update(const cv::Vec3d& value) {
+        if (!primed) {
+            // Start from steady state so the first frames do not ramp up from zero
+            w1 = w2 = w3 = value;
+            primed = true;
+        }
+        cv::Vec3d w = gain * value + b1 * w1 + b2 * w2 + b3 * w3;
+        w3 = w2;
+        w2 = w1;
+        w1 = w;
+        return w;
+    }
+
+    // Feeds the current output back in as the input.
+    cv::Vec3d predict() {
+        return update(primed ? w1 : cv::Vec3d(0, 0, 0));
+    }
+
+private:
+    double b1, b2, b3, gain;
+    cv::Vec3d w1, w2, w3;
+    bool primed;
+};
+
+// Constant-velocity Kalman filter over (dx, dy, da), the model the
+// stabilizers used before the smoothers were split out.
+class KalmanSmoother : public TrajectorySmoother {
+public:
+    KalmanSmoother(double process_noise_cov, double measurement_noise_cov) {
+        kalman.init(6, 3, 0);
+        kalman.transitionMatrix = (cv::Mat_<float>(6, 6) <<
+            1, 0, 0, 1, 0, 0,
+            0, 1, 0, 0, 1, 0,
+            0, 0, 1, 0, 0, 1,
+            0, 0, 0, 1, 0, 0,
+            0, 0, 0, 0, 1, 0,
+            0, 0, 0, 0, 0, 1);
+        kalman.measurementMatrix = cv::Mat::eye(3, 6, CV_32F);
+        cv::setIdentity(kalman.processNoiseCov, cv::Scalar::all(process_noise_cov));
+        cv::setIdentity(kalman.measurementNoiseCov, cv::Scalar::all(measurement_noise_cov));
+        measurement.create(3, 1, CV_32F);
+        reset();
+    }
+
+    void reset() {
+        kalman.statePost = cv::Mat::zeros(6, 1, CV_32F);
+        cv::setIdentity(kalman.errorCovPost, cv::Scalar::all(1));
+    }
+
+    cv::Vec3d update(const cv::Vec3d& value) {
+        measurement.at<float>(0) = static_cast<float>(value[0]);
+        measurement.at<float>(1) = static_cast<float>(value[1]);
+        measurement.at<float>(2) = static_cast<float>(value[2]);
+        kalman.predict();
+        const cv::Mat& state = kalman.correct(measurement);
+        return cv::Vec3d(state.at<float>(0), state.at<float>(1), state.at<float>(2));
+    }
+
+    // Constant-velocity extrapolation; predict() also carries the state over
+    // to the next frame when there is no correction.
+    cv::Vec3d predict() {
+        const cv::Mat& state = kalman.predict();
+        return cv::Vec3d(state.at<float>(0), state.at<float>(1), state.at<float>(2));
+    }
+
+private:
+    cv::KalmanFilter kalman;
+    cv::Mat measurement;
+};
+
+enum SmootherType {
+    SMOOTHER_MOVING_AVERAGE,
+    SMOOTHER_GAUSSIAN,
+    SMOOTHER_KALMAN
+};
+
+// Smoother of `type` sized for a stabilizer with the given smoothing radius.
+inline cv::Ptr<TrajectorySmoother> create_trajectory_smoother(SmootherType type, int smoothing_radius,
+                                                             double process_noise_cov = 1e-3,
+                                                             double measurement_noise_cov = 1e-1) {
+    switch (type) {
+    case SMOOTHER_MOVING_AVERAGE:
+        return cv::makePtr<MovingAverageSmoother>(smoothing_radius);
+    case SMOOTHER_GAUSSIAN:
+        // Same variance as a moving average over smoothing_radius frames
+        return cv::makePtr<RecursiveGaussianSmoother>(smoothing_radius / std::sqrt(12.0));
+    case SMOOTHER_KALMAN:
+    default:
+        return cv::makePtr<KalmanSmoother>(process_noise_cov, measurement_noise_cov);
+    }
+}
+
+// Parses "average", "gaussian" or "kalman".
+inline bool parse_smoother_type(const std::string& name, SmootherType& type) {
+    if (name == "average") type = SMOOTHER_MOVING_AVERAGE;
+    else if (name == "gaussian") type = SMOOTHER_GAUSSIAN;
+    else if (name == "kalman") type = SMOOTHER_KALMAN;
+    else return false;
+    return true;
+}
+
+#endif // TRAJECTORY_SMOOTHER_H
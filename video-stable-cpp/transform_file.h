@@ -0,0 +1,112 @@
+#ifndef TRANSFORM_FILE_H
+#define TRANSFORM_FILE_H
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Per-frame result of the offline motion pass, as (dx, dy, da) triples.
+struct TransformRecord {
+    cv::Vec3d raw;         // motion relative to the previous frame
+    cv::Vec3d trajectory;  // cumulative sum of raw
+    cv::Vec3d smoothed;    // smoothed trajectory
+
+    // Transform to warp this frame with, as in the Python VidStab.
+    cv::Vec3d correction() const {
+        return raw + (smoothed - trajectory);
+    }
+};
+
+// Fills trajectory and smoothed from raw. The smoothing is the trailing
+// rolling mean with back-fill used by bfill_rolling_mean in the Python
+// VidStab; windows longer than the video are clamped to its length.
+inline void smooth_trajectory(std::vector<TransformRecord>& records, int window) {
+    if (records.empty()) return;
+    int n = std::max(1, std::min(window, static_cast<int>(records.size())));
+
+    cv::Vec3d cumulative(0, 0, 0);
+    for (size_t i = 0; i < records.size(); i++) {
+        cumulative += records[i].raw;
+        records[i].trajectory = cumulative;
+    }
+
+    cv::Vec3d window_sum(0, 0, 0);
+    for (size_t i = 0; i < records.size(); i++) {
+        window_sum += records[i].trajectory;
+        if (i >= static_cast<size_t>(n)) window_sum -= records[i - n].trajectory;
+        if (i + 1 >= static_cast<size_t>(n)) records[i].smoothed = window_sum / static_cast<double>(n);
+    }
+    for (int i = 0; i < n - 1; i++) {
+        records[i].smoothed = records[n - 1].smoothed;
+    }
+}
+
+// Binary transform file, host byte order:
+//   char[4] magic "VSTF", uint32 version, uint32 width, uint32 height,
+//   uint64 frame count, then per frame 9 doubles: raw, trajectory, smoothed.
+static const char TRANSFORM_FILE_MAGIC[4] = {'V', 'S', 'T', 'F'};
+static const uint32_t TRANSFORM_FILE_VERSION = 1;
+
+inline void write_transform_file(const std::string& path, const std::vector<TransformRecord>& records, cv::Size frame_size) {
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out) throw std::runtime_error("Cannot open transform file for writing: " + path);
+
+    uint32_t header[3] = {TRANSFORM_FILE_VERSION, static_cast<uint32_t>(frame_size.width), static_cast<uint32_t>(frame_size.height)};
+    uint64_t count = records.size();
+    out.write(TRANSFORM_FILE_MAGIC, sizeof(TRANSFORM_FILE_MAGIC));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+    for (size_t i = 0; i < records.size(); i++) {
+        double row[9];
+        for (int j = 0; j < 3; j++) {
+            row[j] = records[i].raw[j];
+            row[3 + j] = records[i].trajectory[j];
+            row[6 + j] = records[i].smoothed[j];
+        }
+        out.write(reinterpret_cast<const char*>(row), sizeof(row));
+    }
+    if (!out) throw std::runtime_error("Failed writing transform file: " + path);
+}
+
+inline std::vector<TransformRecord> read_transform_file(const std::string& path, cv::Size* frame_size = 0) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open transform file: " + path);
+
+    char magic[4];
+    uint32_t header[3];
+    uint64_t count = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || std::memcmp(magic, TRANSFORM_FILE_MAGIC, sizeof(magic)) != 0 || header[0] != TRANSFORM_FILE_VERSION) {
+        throw std::runtime_error("Not a version " + std::to_string(TRANSFORM_FILE_VERSION) + " transform file: " + path);
+    }
+    if (frame_size) *frame_size = cv::Size(header[1], header[2]);
+
+    // Check the frame count against the file size before allocating for it
+    const uint64_t row_bytes = 9 * sizeof(double);
+    std::streampos data_start = in.tellg();
+    in.seekg(0, std::ios::end);
+    uint64_t data_bytes = static_cast<uint64_t>(in.tellg() - data_start);
+    in.seekg(data_start);
+    if (!in || count > data_bytes / row_bytes) throw std::runtime_error("Truncated transform file: " + path);
+
+    std::vector<TransformRecord> records(static_cast<size_t>(count));
+    for (size_t i = 0; i < records.size(); i++) {
+        double row[9];
+        in.read(reinterpret_cast<char*>(row), sizeof(row));
+        if (!in) throw std::runtime_error("Truncated transform file: " + path);
+        records[i].raw = cv::Vec3d(row[0], row[1], row[2]);
+        records[i].trajectory = cv::Vec3d(row[3], row[4], row[5]);
+        records[i].smoothed = cv::Vec3d(row[6], row[7], row[8]);
+    }
+    return records;
+}
+
+#endif // TRANSFORM_FILE_H
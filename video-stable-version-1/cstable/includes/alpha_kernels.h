@@ -0,0 +1,36 @@
+#ifndef ALPHA_KERNELS_H
+#define ALPHA_KERNELS_H
+
+#include <opencv4/opencv2/core.hpp>
+
+// Row-wise BGRA alpha kernels used by border_frame and layer_overlay.
+// They run on SSE2 where it is available and fall back to plain loops elsewhere;
+// both paths give identical results.
+
+// Sets alpha to 255 inside `opaque` and to 0 everywhere else, leaving BGR untouched.
+void fill_alpha_rect(
+    cv::Mat& bgra,
+    const cv::Rect& opaque
+);
+
+// Takes `background` wherever `foreground` is fully transparent and
+// `foreground` elsewhere, with alpha forced to 255.
+void overlay_transparent(
+    const cv::Mat& foreground,
+    const cv::Mat& background,
+    cv::Mat& overlaid
+);
+
+// Scalar versions of the kernels above, kept for comparison.
+void fill_alpha_rect_scalar(
+    cv::Mat& bgra,
+    const cv::Rect& opaque
+);
+
+void overlay_transparent_scalar(
+    const cv::Mat& foreground,
+    const cv::Mat& background,
+    cv::Mat& overlaid
+);
+
+#endif // ALPHA_KERNELS_H
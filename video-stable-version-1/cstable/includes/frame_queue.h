@@ -3,10 +3,11 @@
 
 #include <iostream>
 #include <opencv4/opencv2/opencv.hpp>
-#include <deque>
 #include <vector>
 #include <stdexcept>
 #include <limits>
+#include <optional>
+#include <utility>
 #include "frame.h"
 #include "pop_deque.h"
 
@@ -16,18 +17,19 @@ class FrameQueue {
 public:
     FrameQueue(size_t max_len = std::numeric_limits<size_t>::max(), size_t max_frames = std::numeric_limits<size_t>::max())
         : max_len(max_len), max_frames(max_frames), _max_frames(max_frames),
-          frames(max_len), inds(max_len), i(0), source_fps(30), grabbed_frame(false) {}
+          frames(max_len), inds(max_len), i(0), source(nullptr), source_fps(30), grabbed_frame(false) {}
 
     void reset_queue(size_t max_len = std::numeric_limits<size_t>::max(), size_t max_frames = std::numeric_limits<size_t>::max()) {
-        max_len = max_len != std::numeric_limits<size_t>::max() ? max_len : this->max_len;
-        max_frames = max_frames != std::numeric_limits<size_t>::max() ? max_frames : this->max_frames;
+        this->max_len = max_len != std::numeric_limits<size_t>::max() ? max_len : this->max_len;
+        this->max_frames = max_frames != std::numeric_limits<size_t>::max() ? max_frames : this->max_frames;
 
-        if (max_frames != std::numeric_limits<size_t>::max()) {
-            _max_frames = max_frames + 1;
+        if (this->max_frames != std::numeric_limits<size_t>::max()) {
+            _max_frames = this->max_frames + 1;
         }
 
-        frames.clear();
-        inds.clear();
+        // Ring buffers keep their slots unless the window size changed.
+        frames.reset(this->max_len);
+        inds.reset(this->max_len);
         i = 0;
     }
 
@@ -54,11 +56,22 @@ public:
         return _append_frame(frame, pop_ind);
     }
 
+    // Frame by absolute frame number, as long as it is still in the window.
+    const Frame& frame_at(size_t frame_index) const {
+        return frames.get(frame_index);
+    }
+
+    bool has_frame(size_t frame_index) const {
+        return frames.contains_index(frame_index);
+    }
+
 private:
     std::tuple<size_t, Frame, bool> _append_frame(const cv::Mat& frame, bool pop_ind = true) {
         Frame popped_frame;
         if (!frame.empty()) {
-            frames.pop_append(Frame(frame));
+            if (std::optional<Frame> popped = frames.pop_append(Frame(frame))) {
+                popped_frame = std::move(*popped);
+            }
             inds.pop_append(i);
             i++;
         }
@@ -4,10 +4,8 @@
 
 #include <iostream>
 #include <climits>
-
-namespace cv{
-    class Mat;
-}
+#include <vector>
+#include <opencv4/opencv2/core.hpp>
 
 
 cv::Mat bfill_rolling_mean(
@@ -15,6 +13,38 @@ cv::Mat bfill_rolling_mean(
     int n = 30
 );
 
+// Streaming counterpart of bfill_rolling_mean: trajectory rows go in one at a
+// time and smoothed rows come out as soon as their window is complete. Only
+// the last n + 1 cumulative sums are kept, so memory is bounded by the window
+// whatever the video length, and the output is identical to the batch function.
+class BfillRollingMean {
+public:
+    explicit BfillRollingMean(
+        int n = 30
+    );
+
+    // Feeds the next row and returns how many smoothed rows it released:
+    // none while the first window fills, n when it completes (the back-filled
+    // rows), one for every row after that. All released rows equal smoothed().
+    int push(
+        const cv::Vec3d& row
+    );
+
+    __always_inline const cv::Vec3d& smoothed() const {
+        return current;
+    }
+
+    __always_inline size_t rows() const {
+        return count;
+    }
+
+private:
+    int n;
+    std::vector<cv::Vec3d> cumsum;
+    size_t count;
+    cv::Vec3d current;
+};
+
 // Helper function to create progress bar for stabilizing processes
 class IncrementalBar {
 public:
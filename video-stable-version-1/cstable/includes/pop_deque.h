@@ -1,57 +1,177 @@
 #ifndef POP_DEQUE_H
 #define POP_DEQUE_H
 
-#include <deque>
-#include <stdexcept>
 #include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
+// Fixed-capacity ring buffer with the semantics of a Python deque(maxlen=...).
+//
+// A bounded PopDeque allocates its `maxlen` slots once; appending to a full
+// deque overwrites the oldest slot in place. Elements are moved in and out,
+// never copied. Every appended element gets an absolute number (0 for the
+// first one after construction or clear()), and get() addresses any element
+// still held by that number in O(1). An unbounded PopDeque grows its storage
+// geometrically instead.
 template <typename T>
-class PopDeque : public std::deque<T> {
+class PopDeque {
 public:
-    PopDeque(size_t maxlen = std::numeric_limits<size_t>::max()) : maxlen(maxlen) {}
+    explicit PopDeque(size_t maxlen = std::numeric_limits<size_t>::max()) : maxlen(maxlen), head(0), count(0), first(0) {
+        if (bounded()) {
+            slots.resize(maxlen);
+        }
+    }
+
+    // Empties the deque and sets a new capacity, reallocating only if it changed.
+    void reset(size_t maxlen) {
+        if (maxlen != this->maxlen) {
+            this->maxlen = maxlen;
+            slots.clear();
+            slots.shrink_to_fit();
+            if (bounded()) {
+                slots.resize(maxlen);
+            }
+        }
+        clear();
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+        first = 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
 
     bool deque_full() const {
-        return this->size() == maxlen;
+        return count == maxlen;
     }
 
-    T pop_append(const T& x) {
-        T popped_element;
-        if (deque_full()) {
-            popped_element = this->front();
-            this->pop_front();
+    // Appends `x`; returns the element it pushed out when the deque was full.
+    std::optional<T> pop_append(T x) {
+        if (maxlen == 0) {
+            return std::optional<T>(std::move(x));
         }
 
-        this->push_back(x);
+        if (deque_full()) {
+            std::optional<T> popped_element(std::move(slots[head]));
+            slots[head] = std::move(x);
+            head = wrap(head + 1);
+            first++;
+            return popped_element;
+        }
 
-        return popped_element;
+        if (count == slots.size()) {
+            grow();
+        }
+        slots[wrap(head + count)] = std::move(x);
+        count++;
+        return std::nullopt;
     }
 
-    T increment_append(T increment = 1, bool pop_append = true) {
-        T popped_element;
-        if (this->empty()) {
-            popped_element = pop_append(0);
-        } else {
-            popped_element = pop_append(this->back() + increment);
-        }
+    // Appends back() + increment (0 when empty), like VidStab's PopDeque.
+    std::optional<T> increment_append(T increment = 1, bool pop_append = true) {
+        std::optional<T> popped_element = this->pop_append(empty() ? T(0) : back() + increment);
 
         if (!pop_append) {
-            return T();
+            return std::nullopt;
         }
 
         return popped_element;
     }
 
     T pop_front() {
-        if (this->empty()) {
+        if (empty()) {
             throw std::out_of_range("PopDeque is empty");
         }
-        T front = this->front();
-        this->pop_front();
-        return front;
+        T front_element = std::move(slots[head]);
+        head = wrap(head + 1);
+        count--;
+        first++;
+        return front_element;
+    }
+
+    T& front() {
+        return slots[head];
+    }
+
+    const T& front() const {
+        return slots[head];
+    }
+
+    T& back() {
+        return slots[wrap(head + count - 1)];
+    }
+
+    const T& back() const {
+        return slots[wrap(head + count - 1)];
+    }
+
+    // Element at `pos` counted from the front.
+    T& operator[](size_t pos) {
+        return slots[wrap(head + pos)];
+    }
+
+    const T& operator[](size_t pos) const {
+        return slots[wrap(head + pos)];
+    }
+
+    // Absolute number of front(); back() is first_index() + size() - 1.
+    size_t first_index() const {
+        return first;
+    }
+
+    bool contains_index(size_t index) const {
+        return index >= first && index - first < count;
+    }
+
+    // Element by absolute number.
+    const T& get(size_t index) const {
+        if (!contains_index(index)) {
+            throw std::out_of_range("PopDeque index is not held");
+        }
+        return (*this)[index - first];
+    }
+
+    T& get(size_t index) {
+        if (!contains_index(index)) {
+            throw std::out_of_range("PopDeque index is not held");
+        }
+        return (*this)[index - first];
     }
 
 private:
+    bool bounded() const {
+        return maxlen != std::numeric_limits<size_t>::max();
+    }
+
+    size_t wrap(size_t pos) const {
+        return pos < slots.size() ? pos : pos - slots.size();
+    }
+
+    // Only reached by unbounded deques: doubles the storage and unrolls the ring.
+    void grow() {
+        std::vector<T> grown(slots.empty() ? 16 : slots.size() * 2);
+        for (size_t n = 0; n < count; n++) {
+            grown[n] = std::move((*this)[n]);
+        }
+        slots.swap(grown);
+        head = 0;
+    }
+
+    std::vector<T> slots;
     size_t maxlen;
+    size_t head;
+    size_t count;
+    size_t first;
 };
 
-#endif // POP_DEQUE_H
\ No newline at end of file
+#endif // POP_DEQUE_H
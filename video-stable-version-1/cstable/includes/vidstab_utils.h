@@ -1,6 +1,10 @@
 #ifndef VIDSTAB_UTILS_H
 #define VIDSTAB_UTILS_H
 
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace cv{class Mat;}
 class Frame;
@@ -20,4 +24,19 @@ std::pair<Frame, std::map<std::string, Frame>> post_process_transformed_frame(
     std::map<std::string, Frame>& layer_options,
     std::map<std::string, int>& extreme_frame_corners,
     int border_size) ;
+
+double processing_resize_scale(
+    const cv::Mat& frame,
+    int processing_max_dim
+);
+
+cv::Mat resize_frame(
+    const cv::Mat& frame,
+    double scale
+);
+
+std::vector<double> rescale_partial_transform(
+    const std::vector<double>& transform,
+    double scale
+);
 #endif // VIDSTAB_UTILS_H
@@ -0,0 +1,123 @@
+#include "../includes/alpha_kernels.h"
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ALPHA_KERNELS_SSE2 1
+#endif
+
+namespace {
+
+const std::uint32_t alpha_mask = 0xFF000000u;
+
+void check_bgra(const cv::Mat& image) {
+    if (image.type() != CV_8UC4) {
+        throw std::invalid_argument("Alpha kernels expect a BGRA (CV_8UC4) image");
+    }
+}
+
+// Helper function to set the alpha of `n` BGRA pixels, scalar path
+void set_alpha_row_scalar(std::uint8_t* row, int n, std::uint8_t alpha) {
+    for (int x = 0; x < n; ++x) {
+        row[4 * x + 3] = alpha;
+    }
+}
+
+// Helper function to overlay `n` BGRA pixels, scalar path
+void overlay_row_scalar(const std::uint8_t* fg, const std::uint8_t* bg, std::uint8_t* dst, int n) {
+    for (int x = 0; x < n; ++x) {
+        const std::uint8_t* src = fg[4 * x + 3] == 0 ? bg + 4 * x : fg + 4 * x;
+        dst[4 * x] = src[0];
+        dst[4 * x + 1] = src[1];
+        dst[4 * x + 2] = src[2];
+        dst[4 * x + 3] = 255;
+    }
+}
+
+#ifdef ALPHA_KERNELS_SSE2
+// Helper function to set the alpha of `n` BGRA pixels, four pixels per step
+void set_alpha_row(std::uint8_t* row, int n, std::uint8_t alpha) {
+    const __m128i keep = _mm_set1_epi32(static_cast<int>(~alpha_mask));
+    const __m128i fill = _mm_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(alpha) << 24));
+    int x = 0;
+    for (; x + 4 <= n; x += 4) {
+        __m128i* p = reinterpret_cast<__m128i*>(row + 4 * x);
+        __m128i v = _mm_loadu_si128(p);
+        _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(v, keep), fill));
+    }
+    set_alpha_row_scalar(row + 4 * x, n - x, alpha);
+}
+
+// Helper function to overlay `n` BGRA pixels, four pixels per step
+void overlay_row(const std::uint8_t* fg, const std::uint8_t* bg, std::uint8_t* dst, int n) {
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(alpha_mask));
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 4 <= n; x += 4) {
+        __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fg + 4 * x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + 4 * x));
+        __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(f, alpha), zero);
+        __m128i picked = _mm_or_si128(_mm_and_si128(transparent, b), _mm_andnot_si128(transparent, f));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_or_si128(picked, alpha));
+    }
+    overlay_row_scalar(fg + 4 * x, bg + 4 * x, dst + 4 * x, n - x);
+}
+#else
+void set_alpha_row(std::uint8_t* row, int n, std::uint8_t alpha) {
+    set_alpha_row_scalar(row, n, alpha);
+}
+
+void overlay_row(const std::uint8_t* fg, const std::uint8_t* bg, std::uint8_t* dst, int n) {
+    overlay_row_scalar(fg, bg, dst, n);
+}
+#endif
+
+template <typename SetAlphaRow>
+void fill_alpha_rect_rows(cv::Mat& bgra, const cv::Rect& opaque, SetAlphaRow set_row) {
+    check_bgra(bgra);
+    cv::Rect inside = opaque & cv::Rect(0, 0, bgra.cols, bgra.rows);
+
+    for (int y = 0; y < bgra.rows; ++y) {
+        std::uint8_t* row = bgra.ptr<std::uint8_t>(y);
+        if (y < inside.y || y >= inside.y + inside.height || inside.width == 0) {
+            set_row(row, bgra.cols, 0);
+            continue;
+        }
+        set_row(row, inside.x, 0);
+        set_row(row + 4 * inside.x, inside.width, 255);
+        set_row(row + 4 * (inside.x + inside.width), bgra.cols - inside.x - inside.width, 0);
+    }
+}
+
+template <typename OverlayRow>
+void overlay_transparent_rows(const cv::Mat& foreground, const cv::Mat& background, cv::Mat& overlaid, OverlayRow overlay) {
+    check_bgra(foreground);
+    check_bgra(background);
+    if (foreground.size() != background.size()) {
+        throw std::invalid_argument("Foreground and background must have the same size");
+    }
+
+    overlaid.create(foreground.size(), CV_8UC4);
+    for (int y = 0; y < foreground.rows; ++y) {
+        overlay(foreground.ptr<std::uint8_t>(y), background.ptr<std::uint8_t>(y), overlaid.ptr<std::uint8_t>(y), foreground.cols);
+    }
+}
+
+} // namespace
+
+void fill_alpha_rect(cv::Mat& bgra, const cv::Rect& opaque) {
+    fill_alpha_rect_rows(bgra, opaque, set_alpha_row);
+}
+
+void overlay_transparent(const cv::Mat& foreground, const cv::Mat& background, cv::Mat& overlaid) {
+    overlay_transparent_rows(foreground, background, overlaid, overlay_row);
+}
+
+void fill_alpha_rect_scalar(cv::Mat& bgra, const cv::Rect& opaque) {
+    fill_alpha_rect_rows(bgra, opaque, set_alpha_row_scalar);
+}
+
+void overlay_transparent_scalar(const cv::Mat& foreground, const cv::Mat& background, cv::Mat& overlaid) {
+    overlay_transparent_rows(foreground, background, overlaid, overlay_row_scalar);
+}
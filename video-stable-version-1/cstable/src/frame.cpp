@@ -1 +1,47 @@
-// TODO Перенести из header реализацию
\ No newline at end of file
+#include "../includes/frame.h"
+
+Frame::Frame(const cv::Mat& image, ColorFormat color_format) : color_format(color_format) {
+    images[static_cast<std::size_t>(color_format)] = image;
+}
+
+// Helper function to get the frame in another color format, converting it once
+cv::Mat Frame::cvt_color(ColorFormat to_format) const {
+    cv::Mat& converted_image = images[static_cast<std::size_t>(to_format)];
+    if (converted_image.empty() && !get_image().empty()) {
+        int color_conversion = lookup_color_conversion(color_format, to_format);
+        cv::cvtColor(get_image(), converted_image, color_conversion);
+    }
+    return converted_image;
+}
+
+// Helper function to guess the color format from the number of channels
+ColorFormat Frame::guess_color_format(const cv::Mat& image) {
+    if (image.channels() == 1) {
+        return ColorFormat::GRAY;
+    } else if (image.channels() == 3) {
+        return ColorFormat::BGR;
+    } else if (image.channels() == 4) {
+        return ColorFormat::BGRA;
+    } else {
+        throw std::runtime_error("Unexpected frame image shape");
+    }
+}
+
+// Helper function to get the cv::cvtColor code between two color formats
+int Frame::lookup_color_conversion(ColorFormat from_format, ColorFormat to_format) {
+    if (from_format == ColorFormat::GRAY && to_format == ColorFormat::BGR) {
+        return cv::COLOR_GRAY2BGR;
+    } else if (from_format == ColorFormat::BGR && to_format == ColorFormat::GRAY) {
+        return cv::COLOR_BGR2GRAY;
+    } else if (from_format == ColorFormat::BGR && to_format == ColorFormat::BGRA) {
+        return cv::COLOR_BGR2BGRA;
+    } else if (from_format == ColorFormat::BGRA && to_format == ColorFormat::BGR) {
+        return cv::COLOR_BGRA2BGR;
+    } else if (from_format == ColorFormat::BGRA && to_format == ColorFormat::GRAY) {
+        return cv::COLOR_BGRA2GRAY;
+    } else if (from_format == ColorFormat::GRAY && to_format == ColorFormat::BGRA) {
+        return cv::COLOR_GRAY2BGRA;
+    } else {
+        throw std::runtime_error("Unsupported color conversion");
+    }
+}
@@ -26,26 +26,49 @@ bool playback_video(const cv::Mat& display_frame, bool playback_flag, int delay,
     return false;
 }
 
-cv::Mat bfill_rolling_mean(const cv::Mat& arr, int n = 30) {
-    if (arr.rows < n) {
-        throw std::invalid_argument("arr.rows cannot be less than n");
+BfillRollingMean::BfillRollingMean(int n) : n(n), cumsum(n + 1), count(0) {
+    if (n < 1) {
+        throw std::invalid_argument("n must be positive");
     }
+}
+
+// Helper function to advance the cumulative sum by one row and take the trailing window mean
+int BfillRollingMean::push(const cv::Vec3d& row) {
+    count++;
     if (n == 1) {
-        return arr;
+        current = row;
+        return 1;
     }
 
-    cv::Mat pre_buffer = cv::Mat::zeros(1, 3, CV_64F);
-    cv::Mat post_buffer = cv::Mat::zeros(n, 3, CV_64F);
-    cv::Mat arr_cumsum;
-    cv::vconcat(std::vector<cv::Mat>{pre_buffer, arr, post_buffer}, arr_cumsum);
+    size_t slots = cumsum.size();
+    cumsum[count % slots] = cumsum[(count - 1) % slots] + row;
+    if (count < static_cast<size_t>(n)) {
+        return 0;
+    }
 
-    cv::Mat buffer_roll_mean = (arr_cumsum.rowRange(n, arr_cumsum.rows) - arr_cumsum.rowRange(0, arr_cumsum.rows - n)) / static_cast<double>(n);
-    cv::Mat trunc_roll_mean = buffer_roll_mean.rowRange(0, buffer_roll_mean.rows - n);
+    current = (cumsum[count % slots] - cumsum[(count - n) % slots]) / static_cast<double>(n);
+    return count == static_cast<size_t>(n) ? n : 1;
+}
 
-    int bfill_size = arr.rows - trunc_roll_mean.rows;
-    cv::Mat bfill = cv::repeat(trunc_roll_mean.row(0), bfill_size, 1);
+cv::Mat bfill_rolling_mean(const cv::Mat& arr, int n) {
+    if (arr.rows < n) {
+        throw std::invalid_argument("arr.rows cannot be less than n");
+    }
+    if (n == 1) {
+        return arr;
+    }
 
-    cv::Mat result;
-    cv::vconcat(std::vector<cv::Mat>{bfill, trunc_roll_mean}, result);
+    cv::Mat result(arr.rows, 3, CV_64F);
+    BfillRollingMean rolling_mean(n);
+    int filled = 0;
+    for (int i = 0; i < arr.rows; ++i) {
+        cv::Vec3d row(arr.at<double>(i, 0), arr.at<double>(i, 1), arr.at<double>(i, 2));
+        for (int released = rolling_mean.push(row); released > 0; --released, ++filled) {
+            const cv::Vec3d& smoothed = rolling_mean.smoothed();
+            result.at<double>(filled, 0) = smoothed[0];
+            result.at<double>(filled, 1) = smoothed[1];
+            result.at<double>(filled, 2) = smoothed[2];
+        }
+    }
     return result;
-}
\ No newline at end of file
+}
@@ -3,22 +3,13 @@
 #include <opencv4/opencv2/imgproc.hpp>
 #include <opencv4/opencv2/highgui.hpp>
 #include "../includes/frame.h"
+#include "../includes/alpha_kernels.h"
 
 // Helper function to put an image over the top of another
 cv::Mat layer_overlay(const cv::Mat& foreground, const cv::Mat& background) {
-    cv::Mat overlaid = foreground.clone();
-    cv::Mat negative_space;
-    cv::inRange(foreground, cv::Scalar(0, 0, 0, 0), cv::Scalar(255, 255, 255, 0), negative_space);
-
-    background.copyTo(overlaid, negative_space);
-
-    // Set the alpha channel to 255
-    for (int y = 0; y < overlaid.rows; ++y) {
-        for (int x = 0; x < overlaid.cols; ++x) {
-            overlaid.at<cv::Vec4b>(y, x)[3] = 255;
-        }
-    }
-
+    // Background shows through where the foreground is fully transparent; alpha ends up at 255
+    cv::Mat overlaid;
+    overlay_transparent(foreground, background, overlaid);
     return overlaid;
 }
 
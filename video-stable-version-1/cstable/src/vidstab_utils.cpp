@@ -3,6 +3,7 @@
 #include "../includes/border_utils.h"
 #include "../includes/layer_utils.h"
 #include "../includes/frame.h"
+#include "../includes/alpha_kernels.h"
 #include <opencv4/opencv2/opencv.hpp>
 #include <opencv4/opencv2/imgproc.hpp>
 #include <opencv4/opencv2/highgui.hpp>
@@ -35,16 +36,13 @@ std::pair<cv::Mat, int> border_frame(const Frame& frame, int border_size, const
     cv::Mat bordered_frame_image;
     cv::copyMakeBorder(frame.get_image(), bordered_frame_image, border_size, border_size, border_size, border_size, border_mode, cv::Scalar(0, 0, 0));
 
-    cv::Mat alpha_bordered_frame = frame.get_bgra_image();
-    alpha_bordered_frame.setTo(cv::Scalar(0, 0, 0, 0));
+    // The BGRA image belongs to the local bordered frame, so writing the alpha
+    // channel cannot touch the images cached by the caller's frame.
+    Frame bordered_frame(bordered_frame_image, frame.get_color_format());
+    cv::Mat alpha_bordered_frame = bordered_frame.get_bgra_image();
     int h = frame.get_image().rows;
     int w = frame.get_image().cols;
-
-    for (int y = border_size; y < border_size + h; ++y) {
-        for (int x = border_size; x < border_size + w; ++x) {
-            alpha_bordered_frame.at<cv::Vec4b>(y, x)[3] = 255;
-        }
-    }
+    fill_alpha_rect(alpha_bordered_frame, cv::Rect(border_size, border_size, w, h));
 
     return {alpha_bordered_frame, border_mode};
 }
@@ -79,6 +77,30 @@ std::vector<double> estimate_partial_transform(const std::pair<std::vector<cv::P
     }
 }
 
+// Helper function to get the factor that fits a frame's largest dimension within processing_max_dim
+double processing_resize_scale(const cv::Mat& frame, int processing_max_dim) {
+    int max_dim_size = std::max(frame.rows, frame.cols);
+    if (processing_max_dim <= 0 || max_dim_size <= processing_max_dim) {
+        return 1.0;
+    }
+    return static_cast<double>(processing_max_dim) / max_dim_size;
+}
+
+// Helper function to shrink a frame before keypoint detection, optical flow and transform estimation
+cv::Mat resize_frame(const cv::Mat& frame, double scale) {
+    if (scale == 1.0) {
+        return frame;
+    }
+    cv::Mat resized;
+    cv::resize(frame, resized, cv::Size(), scale, scale, cv::INTER_AREA);
+    return resized;
+}
+
+// Helper function to map a [dx, dy, da] transform estimated on a resized frame back to full resolution
+std::vector<double> rescale_partial_transform(const std::vector<double>& transform, double scale) {
+    return {transform[0] / scale, transform[1] / scale, transform[2]};
+}
+
 // Helper function to transform a frame
 Frame transform_frame(const Frame& frame, const cv::Mat& transform, int border_size, const std::string& border_type) {
     if (border_type != "black" && border_type != "reflect" && border_type != "replicate") {
@@ -93,7 +115,7 @@ Frame transform_frame(const Frame& frame, const cv::Mat& transform, int border_s
     cv::Mat transformed_frame_image;
     cv::warpAffine(bordered_frame_image, transformed_frame_image, transform_matrix, cv::Size(w, h), border_mode);
 
-    return Frame(transformed_frame_image, "BGRA");
+    return Frame(transformed_frame_image, ColorFormat::BGRA);
 }
 
 // Helper function to post-process transformed frame